@@ -60,7 +60,7 @@ SPI_HandleTypeDef hspi2;
 SRAM_HandleTypeDef hsram1;
 
 /* USER CODE BEGIN PV */
-uint8_t frameBuffer[ILI9341_PIXEL_COUNT] = {0};
+uint8_t frameBuffer[ILI9341_PIXEL_COUNT] __attribute__((aligned(4))) = {0};
 
 uint8_t touch_it = 0;
 /* USER CODE END PV */
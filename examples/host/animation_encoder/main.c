@@ -0,0 +1,265 @@
+/*
+ * main.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: k-omura
+ *
+ * Converts raw frames (width * height bytes each, 8bit pixel values) into the delta animation
+ * stream played by bitmap_animationOpen/bitmap_animationNext (format in bitmap.h).
+ * gcc -O2 examples/host/animation_encoder/main.c -o animation_encoder
+ * ./animation_encoder 64 64 frames.raw anim.bin        (binary)
+ * ./animation_encoder 64 64 frames.raw anim.h spinner  (C array "spinner")
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GAP 3 //unchanged pixels that are cheaper to resend than to start a new span
+
+static uint8_t *out;
+static uint32_t outSize;
+static uint32_t outCapacity;
+
+static void put(uint8_t _byte) {
+	if (outSize == outCapacity) {
+		outCapacity = outCapacity ? (outCapacity * 2) : 4096;
+		out = realloc(out, outCapacity);
+		if (out == NULL) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+	out[outSize++] = _byte;
+}
+
+static void put16(uint32_t _value) {
+	put(_value & 0xff);
+	put((_value >> 8) & 0xff);
+}
+
+static void put32(uint32_t _value) {
+	put16(_value & 0xffff);
+	put16(_value >> 16);
+}
+
+static void putSkip(uint32_t _skip) {
+	while (_skip >= 0x80) {
+		put((_skip & 0x7f) | 0x80);
+		_skip >>= 7;
+	}
+	put(_skip);
+}
+
+//length of the next packet at _src (max 128) and whether it is a run
+static uint32_t packet(const uint8_t *_src, uint32_t _n, uint8_t *_run) {
+	uint32_t r = 1;
+	while ((r < _n) && (r < 128) && (_src[r] == _src[0])) {
+		r++;
+	}
+	if (r >= 3) {
+		*_run = 1;
+		return r;
+	}
+	//literal up to the next run of 3
+	uint32_t l = 0;
+	while ((l < _n) && (l < 128)) {
+		if (((l + 2) < _n) && (_src[l] == _src[l + 1]) && (_src[l] == _src[l + 2])) {
+			break;
+		}
+		l++;
+	}
+	*_run = 0;
+	return l;
+}
+
+static void putPacket(const uint8_t *_src, uint32_t _length, uint8_t _run) {
+	if (_run) {
+		put(0x80 | (_length - 1));
+		put(_src[0]);
+	} else {
+		put(_length - 1);
+		for (uint32_t i = 0; i < _length; i++) {
+			put(_src[i]);
+		}
+	}
+}
+
+static void keyframe(const uint8_t *_frame, uint32_t _pixels) {
+	put(0);
+	uint32_t sizeAt = outSize;
+	put32(0);
+	uint32_t i = 0;
+	while (i < _pixels) {
+		uint8_t run;
+		uint32_t length = packet(&_frame[i], _pixels - i, &run);
+		putPacket(&_frame[i], length, run);
+		i += length;
+	}
+	uint32_t size = outSize - sizeAt - 4;
+	outSize = sizeAt;
+	put32(size);
+	outSize += size;
+}
+
+static void delta(const uint8_t *_prev, const uint8_t *_frame, uint16_t _width, uint16_t _height) {
+	int32_t x0 = _width, y0 = _height, x1 = -1, y1 = -1;
+	for (uint32_t y = 0; y < _height; y++) {
+		for (uint32_t x = 0; x < _width; x++) {
+			if (_prev[y * _width + x] != _frame[y * _width + x]) {
+				if ((int32_t) x < x0) x0 = x;
+				if ((int32_t) x > x1) x1 = x;
+				if ((int32_t) y < y0) y0 = y;
+				if ((int32_t) y > y1) y1 = y;
+			}
+		}
+	}
+
+	put(1);
+	uint32_t sizeAt = outSize;
+	put32(0);
+	if (x1 < 0) {
+		//no change
+		put16(1);
+		put16(1);
+		put16(0);
+		put16(0);
+		put16(0);
+	} else {
+		put16(x0);
+		put16(y0);
+		put16(x1);
+		put16(y1);
+	}
+	uint32_t spansAt = outSize;
+	put16(0);
+
+	uint32_t spans = 0;
+	uint32_t pos = 0;
+	for (int32_t y = y0; y <= y1; y++) {
+		const uint8_t *row = &_frame[y * _width];
+		const uint8_t *prevRow = &_prev[y * _width];
+		int32_t x = x0;
+		while (x <= x1) {
+			if (row[x] == prevRow[x]) {
+				x++;
+				continue;
+			}
+			//changed span, bridging short unchanged gaps
+			int32_t end = x;
+			int32_t scan = x + 1;
+			while ((scan <= x1) && (scan <= (end + GAP))) {
+				if (row[scan] != prevRow[scan]) {
+					end = scan;
+				}
+				scan++;
+			}
+
+			int32_t i = x;
+			while (i <= end) {
+				uint8_t run;
+				uint32_t length = packet(&row[i], end - i + 1, &run);
+				uint32_t at = y * _width + i;
+				putSkip(at - pos);
+				putPacket(&row[i], length, run);
+				pos = at + length;
+				i += length;
+				spans++;
+			}
+			x = end + 1;
+		}
+	}
+	if (spans > 0xffff) {
+		fprintf(stderr, "too many spans in one frame\n");
+		exit(1);
+	}
+	out[spansAt] = spans & 0xff;
+	out[spansAt + 1] = spans >> 8;
+
+	uint32_t size = outSize - sizeAt - 4;
+	outSize = sizeAt;
+	put32(size);
+	outSize += size;
+}
+
+//delta record, or a keyframe when that is not larger
+static void frameRecord(const uint8_t *_prev, const uint8_t *_frame, uint16_t _width, uint16_t _height) {
+	uint32_t start = outSize;
+	delta(_prev, _frame, _width, _height);
+	uint32_t deltaSize = outSize - start;
+
+	uint8_t *saved = malloc(deltaSize);
+	memcpy(saved, &out[start], deltaSize);
+	outSize = start;
+	keyframe(_frame, (uint32_t) _width * _height);
+	if ((outSize - start) > deltaSize) {
+		outSize = start;
+		for (uint32_t i = 0; i < deltaSize; i++) {
+			put(saved[i]);
+		}
+	}
+	free(saved);
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 5) {
+		fprintf(stderr, "usage: %s width height frames.raw out.bin|out.h [name]\n", argv[0]);
+		return 1;
+	}
+	uint16_t width = atoi(argv[1]);
+	uint16_t height = atoi(argv[2]);
+	uint32_t pixels = (uint32_t) width * height;
+
+	FILE *f = fopen(argv[3], "rb");
+	if ((f == NULL) || (pixels == 0)) {
+		fprintf(stderr, "cannot read %s\n", argv[3]);
+		return 1;
+	}
+	fseek(f, 0, SEEK_END);
+	uint32_t frames = ftell(f) / pixels;
+	fseek(f, 0, SEEK_SET);
+	uint8_t *raw = malloc((size_t) frames * pixels);
+	if ((frames == 0) || (frames > 0xfffe) || (fread(raw, pixels, frames, f) != frames)) {
+		fprintf(stderr, "%s: need 1 to 65534 frames of %ux%u\n", argv[3], width, height);
+		return 1;
+	}
+	fclose(f);
+
+	//header, then frame 0 as keyframe, deltas, and a delta from the last frame back to frame 0
+	uint16_t records = (frames > 1) ? (frames + 1) : 1;
+	put('D');
+	put('A');
+	put16(width);
+	put16(height);
+	put16(records);
+	put16((frames > 1) ? 1 : 0);
+	keyframe(raw, pixels);
+	for (uint32_t i = 1; i < frames; i++) {
+		frameRecord(&raw[(i - 1) * pixels], &raw[i * pixels], width, height);
+	}
+	if (frames > 1) {
+		frameRecord(&raw[(frames - 1) * pixels], raw, width, height);
+	}
+
+	f = fopen(argv[4], "wb");
+	if (f == NULL) {
+		fprintf(stderr, "cannot write %s\n", argv[4]);
+		return 1;
+	}
+	size_t length = strlen(argv[4]);
+	if ((length > 2) && (strcmp(&argv[4][length - 2], ".h") == 0)) {
+		const char *name = (argc > 5) ? argv[5] : "animation";
+		fprintf(f, "//%u frames %ux%u, %u bytes (raw %u)\n", frames, width, height, outSize, frames * pixels);
+		fprintf(f, "static const uint8_t %s[%u] = {", name, outSize);
+		for (uint32_t i = 0; i < outSize; i++) {
+			fprintf(f, "%s0x%02x,", ((i % 16) == 0) ? "\n\t" : " ", out[i]);
+		}
+		fprintf(f, "\n};\n");
+	} else {
+		fwrite(out, 1, outSize, f);
+	}
+	fclose(f);
+	printf("%u frames %ux%u: %u bytes (raw %u)\n", frames, width, height, outSize, frames * pixels);
+	return 0;
+}
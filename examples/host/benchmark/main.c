@@ -0,0 +1,200 @@
+/*
+ * main.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: k-omura
+ *
+ * Per-primitive benchmark of bitmap.c, run on a PC.
+ * gcc -O2 -include stdint.h -Iinc src/bitmap.c examples/host/benchmark/main.c -o benchmark
+ * (add -DBITMAP_COLOR_FORMAT=BITMAP_RGB565 for the 16bit framebuffer)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <bitmap.h>
+
+#define WIDTH 240
+#define HEIGHT 320
+
+static bitmap_color_t frameBuffer[WIDTH * HEIGHT] __attribute__((aligned(4)));
+static volatile uint32_t sink;
+
+static uint8_t image8[64 * 64];
+static uint8_t image4[32 * 64];
+static bitmap_color_t palette[256];
+static const bitmap_image_t sprite8 = {64, 64, 8, 0, 0, image8, NULL};
+static const bitmap_image_t sprite8pal = {64, 64, 8, 0, 0, image8, palette};
+static const bitmap_image_t sprite4 = {64, 64, 4, 0, 0, image4, palette};
+static const bitmap_image_t sprite4key = {64, 64, 4, BITMAP_IMAGE_KEY, 0, image4, palette};
+static bitmap_color_t cache[64 * 64];
+static bitmap_surface_t widget;
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//fillrect as it was before the span engine: column-major, one unchecked bitmap[width * y + x] store per pixel
+static void pixelFillrect(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, bitmap_color_t _color) {
+	if (bitmap_param.width == 0) {
+		return;
+	}
+	for (uint16_t x = _x0; x <= _x1; x++) {
+		for (uint16_t y = _y0; y <= _y1; y++) {
+			bitmap_param.bitmap[(bitmap_param.width * y) + x] = _color;
+		}
+	}
+}
+
+//bitmap_clear as it was: one store per pixel (a PC compiler vectorizes this, a Cortex-M4 does not)
+static void pixelClear(void) {
+	for (uint32_t i = 0; i < (WIDTH * HEIGHT); i++) {
+		frameBuffer[i] = bitmap_param.background;
+	}
+}
+
+static void fillFull(uint32_t i) {
+	bitmap_fillrect(0, 0, WIDTH - 1, HEIGHT - 1, i);
+}
+static void pixelFillFull(uint32_t i) {
+	pixelFillrect(0, 0, WIDTH - 1, HEIGHT - 1, i);
+}
+static void fillSmall(uint32_t i) {
+	bitmap_fillrect(i % 200, i % 280, (i % 200) + 31, (i % 280) + 31, i);
+}
+static void pixelFillSmall(uint32_t i) {
+	pixelFillrect(i % 200, i % 280, (i % 200) + 31, (i % 280) + 31, i);
+}
+static void clear(uint32_t i) {
+	bitmap_clear();
+}
+static void clearPixel(uint32_t i) {
+	pixelClear();
+}
+static void hspan(uint32_t i) {
+	bitmap_hspan(1, WIDTH - 2, i % HEIGHT, i);
+}
+static void line(uint32_t i) {
+	bitmap_line(0, i % HEIGHT, WIDTH - 1, HEIGHT - 1 - (i % HEIGHT), i);
+}
+static void line45(uint32_t i) {
+	bitmap_line(0, i % 80, 239, (i % 80) + 239, i);
+}
+static void thickline(uint32_t i) {
+	bitmap_thickline(10, i % HEIGHT, WIDTH - 10, HEIGHT - 1 - (i % HEIGHT), 5, i);
+}
+static void rect(uint32_t i) {
+	bitmap_rect(10, 10, 200, 120, 2, i);
+}
+static void fillcircle(uint32_t i) {
+	bitmap_fillcircle(120, 160, 60, 0, i);
+}
+static void fillroundrect(uint32_t i) {
+	bitmap_fillroundrect(20, 20, 220, 100, 12, i);
+}
+static void fillellipse(uint32_t i) {
+	bitmap_fillellipse(120, 160, 100, 50, i);
+}
+static void fillarc(uint32_t i) {
+	bitmap_fillarc(120, 160, 50, 60, 30, 300, i);
+}
+static void string0(uint32_t i) {
+	bitmap_stringBitmap(0, 100, "THE QUICK BROWN FOX", 0, 0, i);
+}
+static void string1(uint32_t i) {
+	bitmap_stringBitmap(0, 100, "The quick brown fox", 1, 0, i);
+}
+static void string3(uint32_t i) {
+	bitmap_stringBitmap(0, 100, "Scaled", 3, 0, i);
+}
+static void stringClipped(uint32_t i) {
+	bitmap_pushClip(0, 0, WIDTH - 1, 50);
+	bitmap_stringBitmap(0, 100, "The quick brown fox", 1, 0, i);
+	bitmap_popClip();
+}
+static void blit8(uint32_t i) {
+	bitmap_blit(&sprite8, i % 176, i % 256);
+}
+static void blit8pal(uint32_t i) {
+	bitmap_blit(&sprite8pal, i % 176, i % 256);
+}
+static void blit4(uint32_t i) {
+	bitmap_blit(&sprite4, i % 176, i % 256);
+}
+static void blit4key(uint32_t i) {
+	bitmap_blit(&sprite4key, i % 176, i % 256);
+}
+static void blitSurface(uint32_t i) {
+	bitmap_blitSurface(&widget, i % 176, i % 256);
+}
+
+static const struct {
+	const char *name;
+	void (*run)(uint32_t);
+	uint32_t loops;
+	uint32_t pixels; //pixels per call, 0: not reported
+} benchmark[] = {
+	{"clear", clear, 2000, WIDTH * HEIGHT},
+	{"clear (plain loop)", clearPixel, 2000, WIDTH * HEIGHT},
+	{"fillrect 240x320", fillFull, 2000, WIDTH * HEIGHT},
+	{"fillrect 240x320 (per pixel)", pixelFillFull, 200, WIDTH * HEIGHT},
+	{"fillrect 32x32", fillSmall, 100000, 32 * 32},
+	{"fillrect 32x32 (per pixel)", pixelFillSmall, 20000, 32 * 32},
+	{"hspan 238", hspan, 1000000, 238},
+	{"line", line, 100000, 0},
+	{"line 45deg", line45, 100000, 240},
+	{"thickline 5px", thickline, 100000, 0},
+	{"rect 2px", rect, 100000, 0},
+	{"fillcircle r60", fillcircle, 20000, 0},
+	{"fillroundrect", fillroundrect, 20000, 0},
+	{"fillellipse 100x50", fillellipse, 20000, 0},
+	{"fillarc r50-60 270deg", fillarc, 20000, 0},
+	{"string 5x3", string0, 100000, 0},
+	{"string size 1", string1, 100000, 0},
+	{"string size 3", string3, 100000, 0},
+	{"string outside clip", stringClipped, 100000, 0},
+	{"blit 64x64 8bpp", blit8, 100000, 64 * 64},
+	{"blit 64x64 8bpp palette", blit8pal, 100000, 64 * 64},
+	{"blit 64x64 4bpp", blit4, 100000, 64 * 64},
+	{"blit 64x64 4bpp key", blit4key, 100000, 64 * 64},
+	{"blitSurface 64x64", blitSurface, 100000, 64 * 64},
+};
+
+int main(void) {
+	bitmap_setparam(WIDTH, HEIGHT, BITMAP_COLOR8(0x00), frameBuffer);
+	for (uint32_t i = 0; i < sizeof(image8); i++) {
+		image8[i] = i * 7;
+	}
+	for (uint32_t i = 0; i < sizeof(image4); i++) {
+		image4[i] = i * 13;
+	}
+	for (uint32_t i = 0; i < 256; i++) {
+		palette[i] = BITMAP_COLOR8(i);
+	}
+	//widget drawn once into a surface, copied every call
+	bitmap_surfaceInit(&widget, cache, 64, 64, 0, BITMAP_COLOR8(0x00));
+	bitmap_surfaceClear(&widget);
+	bitmap_surfaceFillarc(&widget, 32, 32, 20, 30, 30, 300, BITMAP_COLOR8(0x1c));
+	bitmap_surfaceStringBitmap(&widget, 16, 28, "42%", 1, 0, BITMAP_COLOR8(0xff));
+	printf("%d bit framebuffer\n", (int) (8 * sizeof(bitmap_color_t)));
+	printf("%-30s %12s %12s\n", "primitive", "us/call", "Mpixel/s");
+
+	for (uint32_t b = 0; b < (sizeof(benchmark) / sizeof(benchmark[0])); b++) {
+		double start = now();
+		for (uint32_t i = 0; i < benchmark[b].loops; i++) {
+			benchmark[b].run(i);
+			bitmap_clearDirty();
+		}
+		double us = (now() - start) * 1e6 / benchmark[b].loops;
+		sink += frameBuffer[b];
+
+		if (benchmark[b].pixels) {
+			printf("%-30s %12.3f %12.1f\n", benchmark[b].name, us, benchmark[b].pixels / us);
+		} else {
+			printf("%-30s %12.3f %12s\n", benchmark[b].name, us, "-");
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * main.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: k-omura
+ *
+ * TrueType text on a PC: the font file is loaded into memory and used with truetype_setTtfMemory.
+ * gcc -O2 -include stdint.h -DTRUETYPE_USE_FATFS=0 -Iinc src/bitmap.c src/bitmap_truetype.c examples/host/truetype/main.c -o truetype
+ * ./truetype font.ttf [out.pgm]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <bitmap.h>
+#include <bitmap_truetype.h>
+
+#define WIDTH 240
+#define HEIGHT 320
+
+static bitmap_color_t frameBuffer[WIDTH * HEIGHT];
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s font.ttf [out.pgm]\n", argv[0]);
+		return 1;
+	}
+
+	FILE *fp = fopen(argv[1], "rb");
+	if (fp == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+	fseek(fp, 0, SEEK_END);
+	long length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	uint8_t *font = malloc(length);
+	if ((font == NULL) || (fread(font, 1, length, fp) != (size_t) length)) {
+		fprintf(stderr, "%s: read error\n", argv[1]);
+		return 1;
+	}
+	fclose(fp);
+
+	bitmap_setparam(WIDTH, HEIGHT, BITMAP_COLOR8(0x00), frameBuffer);
+	bitmap_clear();
+	uint8_t res = truetype_setTtfMemory(font, length);
+	printf("setTtfMemory: %d\n", res);
+	if (res != 0) {
+		return 1;
+	}
+	truetype_setCharacterSize(40);
+	truetype_setCharacterSpacing(0, 1);
+	truetype_setTextBoundary(0, WIDTH, HEIGHT);
+	truetype_setTextColor(BITMAP_COLOR8(0xff), BITMAP_COLOR8(0xff), 1);
+
+	//the counter of the quick start example
+	uint32_t loops = 1000;
+	double start = now();
+	for (uint32_t i = 0; i < loops; i++) {
+		char string[8];
+		sprintf(string, "%04d", (int) (i % 10000));
+		bitmap_clear();
+		truetype_textDraw(80, 5, string);
+	}
+	printf("%-30s %12.1f us\n", "4 digit counter", (now() - start) * 1e6 / loops);
+	printf("glyph cache: %u hits, %u misses, %u bytes\n", (unsigned) bitmap_truetype_glyphCache.hits, (unsigned) bitmap_truetype_glyphCache.misses, (unsigned) bitmap_truetype_glyphCache.bytes);
+
+	truetype_setGlyphCache(0);
+	start = now();
+	for (uint32_t i = 0; i < loops; i++) {
+		char string[8];
+		sprintf(string, "%04d", (int) (i % 10000));
+		bitmap_clear();
+		truetype_textDraw(80, 5, string);
+	}
+	printf("%-30s %12.1f us\n", "4 digit counter (no cache)", (now() - start) * 1e6 / loops);
+	truetype_setGlyphCache(TRUETYPE_GLYPH_CACHE_BUDGET);
+
+	start = now();
+	for (uint32_t i = 0; i < loops; i++) {
+		truetype_getStringWidth("The quick brown fox");
+	}
+	printf("%-30s %12.1f us\n", "getStringWidth", (now() - start) * 1e6 / loops);
+
+	bitmap_clear();
+	truetype_textDraw(0, 60, "The quick brown fox");
+	if (argc > 2) {
+		//8bit gray image of the framebuffer
+		FILE *out = fopen(argv[2], "wb");
+		if (out != NULL) {
+			fprintf(out, "P5\n%d %d\n255\n", WIDTH, HEIGHT);
+			for (uint32_t i = 0; i < (WIDTH * HEIGHT); i++) {
+				fputc(frameBuffer[i] ? 255 : 0, out);
+			}
+			fclose(out);
+		}
+	}
+	free(font);
+	return 0;
+}
@@ -7,16 +7,32 @@
  * FSMC 8bit
  */
 
+#ifndef DEF_FSMC_ILI9341_H
+#define DEF_FSMC_ILI9341_H
 
 //List of includes
 #include "main.h"
 #include <stdio.h>
+#include "bitmap.h"
 
 //LCD dimensions defines
 #define ILI9341_WIDTH 240
 #define ILI9341_HEIGHT 320
 #define ILI9341_PIXEL_COUNT	(ILI9341_WIDTH * ILI9341_HEIGHT)
 
+//TE synchronized present
+#define ILI9341_TE_TIMEOUT 50 //ms to wait for a TE edge. presentSync presents anyway, an armed presentOnTe frame is dropped
+
+//content-diff flush
+#define ILI9341_DIFF_GAP 8 //unchanged pixels bridged inside a span instead of opening a new window
+
+//async flush
+#if BITMAP_COLOR_FORMAT == BITMAP_RGB565
+#define ILI9341_ASYNC_LINE_PIXELS (ILI9341_PIXEL_COUNT / 2) //RGB565 framebuffer is streamed in place. max 65535
+#else
+#define ILI9341_ASYNC_LINE_PIXELS (ILI9341_WIDTH * 2) //pixels per ping-pong line buffer
+#endif
+
 //ILI9341 commands
 #define LCD_REGSELECT_BIT 18 //LCD Register Select. if A18 -> 18.
 #define LCD_ADDR_BASE 0x60000000
@@ -57,6 +73,7 @@
 #define ILI9341_INTERFACE 0xF6
 #define ILI9341_PRC 0xF7
 #define ILI9341_VERTICAL_SCROLL 0x33
+#define ILI9341_VERTICAL_SCROLL_START 0x37
 
 #define ILI9341_MEMCONTROL 0x36
 #define ILI9341_MADCTL_MY 0x80
@@ -67,6 +84,20 @@
 #define ILI9341_MADCTL_BGR 0x08
 #define ILI9341_MADCTL_MH 0x04
 
+//async flush transport. start() streams _count pixels to LCD_ADDR_DATA and calls ILI9341_transferComplete() when done.
+typedef struct {
+	void (*start)(const uint16_t *_src, uint16_t _count);
+} ILI9341_transport_t;
+
+//display backend. window() opens a GRAM window for writing, pixels() writes RGB565 pixels to it,
+//flush() is called when a frame or a partial update is complete
+typedef struct {
+	void (*command)(uint8_t _cmd, const uint8_t *_data, uint8_t _count);
+	void (*window)(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1);
+	void (*pixels)(const uint16_t *_src, uint32_t _count);
+	void (*flush)(void);
+} ILI9341_backend_t;
+
 //functions
 void ILI9341_sendCommand16(uint16_t);
 void ILI9341_sendData16(uint16_t);
@@ -74,9 +105,39 @@ void ILI9341_sendCommand8(uint8_t);
 void ILI9341_sendData8(uint8_t);
 
 void ILI9341_init(void);
+void ILI9341_initStart(uint8_t);
+uint8_t ILI9341_initPoll(void);
 void ILI9341_setRotation(uint8_t);
 
 void ILI9341_setRect(uint16_t, uint16_t, uint16_t, uint16_t);
-void ILI9341_printBitmap(uint8_t*);
+void ILI9341_printBitmap(bitmap_color_t*);
+void ILI9341_flushDirty(void);
+void ILI9341_fillRect(uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void ILI9341_printList(bitmap_color_t*, uint16_t);
+void ILI9341_setShadow(bitmap_color_t*);
+
+void ILI9341_printBitmapAsync(bitmap_color_t*, void (*_callback)(void));
+uint8_t ILI9341_isBusy(void);
+void ILI9341_transferComplete(void);
+void ILI9341_setTransport(const ILI9341_transport_t*);
+void ILI9341_dmaInit(DMA_HandleTypeDef*);
+
+void ILI9341_setTearing(uint8_t);
+void ILI9341_setTeHook(uint8_t (*_readPin)(void));
+void ILI9341_teIrq(void);
+uint8_t ILI9341_presentSync(bitmap_color_t*, void (*_callback)(void));
+void ILI9341_presentOnTe(bitmap_color_t*, void (*_callback)(void));
+uint32_t ILI9341_getMissedVsync(void);
+
+void ILI9341_setScrollArea(uint16_t, uint16_t);
+void ILI9341_setScrollOffset(uint16_t);
+void ILI9341_terminal(const char _character[], uint8_t, bitmap_color_t, uint8_t);
+
+void ILI9341_setBackend(const ILI9341_backend_t*);
+
+uint32_t ILI9341_getSentPixels(void);
+void ILI9341_resetSentPixels(void);
 
 extern const uint16_t col8to16[256];
+
+#endif /* DEF_FSMC_ILI9341_H */
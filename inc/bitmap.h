@@ -9,14 +9,130 @@
 #define SRC_BITMAP_H_
 
 #include "stdio.h"
+
+#define BITMAP_DIRTY_MAX 8 //number of merged damaged rectangles kept between flushes
+#define BITMAP_CLIP_DEPTH 8 //nested clip rectangles (bitmap_pushClip)
+#define BITMAP_RLE_ROW_MAX 320 //bytes of one packed row of an RLE image. Static decode buffer: RLE bitmap_blit is not reentrant (ISR, nested surface draw)
+
+//framebuffer pixel format. build with -DBITMAP_COLOR_FORMAT=BITMAP_RGB565 for a native 16bit framebuffer
+#define BITMAP_RGB332 0
+#define BITMAP_RGB565 1
+#ifndef BITMAP_COLOR_FORMAT
+#define BITMAP_COLOR_FORMAT BITMAP_RGB332
+#endif
+
+#if BITMAP_COLOR_FORMAT == BITMAP_RGB565
+typedef uint16_t bitmap_color_t;
+//RGB332 value to the framebuffer format (same mapping as col8to16)
+#define BITMAP_COLOR8(c) ((bitmap_color_t)((((((c) >> 5) & 0x07) * 31 + 3) / 7) << 11 | ((((c) >> 2) & 0x07) * 9) << 5 | (((c) & 0x03) * 31 + 1) / 3))
+#else
+typedef uint8_t bitmap_color_t;
+#define BITMAP_COLOR8(c) ((bitmap_color_t)(c))
+#endif
+
 struct bitmap_param_t{
 	uint16_t width;
 	uint16_t height;
-	uint8_t background;
-	uint8_t *bitmap;
+	bitmap_color_t background;
+	bitmap_color_t *bitmap;
 };
 extern struct bitmap_param_t bitmap_param;
 
+//off-screen render target for the bitmap_surface* functions
+typedef struct {
+	bitmap_color_t *bitmap;
+	uint16_t width;
+	uint16_t height;
+	uint16_t stride; //pixels from one row to the next (>= width)
+	bitmap_color_t background; //bitmap_surfaceClear
+} bitmap_surface_t;
+
+//direct rendering target: fills x0,y0-x1,y1 (inclusive, on screen) with one color
+typedef void (*bitmap_direct_t)(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, bitmap_color_t _color);
+
+typedef struct {
+	uint16_t x0;
+	uint16_t y0;
+	uint16_t x1;
+	uint16_t y1;
+} bitmap_rect_t;
+
+struct bitmap_dirty_t{
+	uint8_t count;
+	uint8_t hold; //>0 while a primitive that already marked its bounding box is drawing
+	bitmap_rect_t rect[BITMAP_DIRTY_MAX];
+};
+extern struct bitmap_dirty_t bitmap_dirty;
+
+//image for bitmap_blit
+#define BITMAP_IMAGE_KEY 0x01 //pixels with the value key are not drawn
+#define BITMAP_IMAGE_RLE 0x02 //data is RLE compressed
+typedef struct {
+	uint16_t width;
+	uint16_t height;
+	uint8_t bpp; //1, 2, 4 or 8. rows are packed MSB first and start on a byte
+	uint8_t flags;
+	uint8_t key; //transparent pixel value (palette index) with BITMAP_IMAGE_KEY
+	/*
+	 * raw: height rows of (width * bpp + 7) / 8 bytes.
+	 * RLE: the same bytes as packets: n < 0x80: n + 1 literal bytes follow, n >= 0x80: the next byte repeated (n & 0x7f) + 1 times.
+	 * Packets may run over the end of a row.
+	 */
+	const uint8_t *data;
+	const bitmap_color_t *palette; //color of each value. 8bpp only: NULL = the value is an RGB332 color
+} bitmap_image_t;
+
+/*
+ * Delta animation stream (bitmap_animationOpen), little endian:
+ * header: 'D' 'A', width, height, records, loop (uint16 each). After the last record, playback continues at record loop.
+ * record: type (uint8, 0: keyframe, 1: delta), payload size (uint32), payload.
+ * keyframe: width * height 8bit pixel values, RLE packets as bitmap_image_t.
+ * delta: changed rectangle x0, y0, x1, y1 and span count (uint16 each), then per span:
+ *   pixels skipped since the end of the previous span (LEB128), packet n and its bytes as in RLE. A span stays in one row.
+ * examples/host/animation_encoder converts raw frames.
+ */
+typedef struct {
+	const uint8_t *stream;
+	const uint8_t *next; //next record
+	const uint8_t *loop;
+	uint16_t width;
+	uint16_t height;
+	uint16_t records;
+	uint16_t record; //index of next
+	uint16_t loopRecord;
+	uint16_t x;
+	uint16_t y;
+	const bitmap_color_t *palette; //NULL: pixel values are RGB332 colors
+	bitmap_rect_t changed; //screen area changed by the last bitmap_animationNext
+} bitmap_animation_t;
+
+//display list command (bitmap_setlist)
+typedef struct {
+	uint8_t type;
+	bitmap_color_t color;
+	uint16_t top; //rows covered, for band culling
+	uint16_t bottom;
+	uint16_t p[6];
+	//source of the command, kept by reference
+	union {
+		struct {
+			const uint8_t *frame;
+			const bitmap_color_t *map;
+		} animation; //bitmap_animation_4bit frame and color map
+		const bitmap_image_t *image; //bitmap_blit
+		const bitmap_surface_t *surface; //bitmap_blitSurface
+	} src;
+} bitmap_cmd_t;
+
+struct bitmap_list_t{
+	bitmap_cmd_t *cmd;
+	uint16_t size;
+	uint16_t count;
+	uint8_t overflow; //commands were dropped since the last bitmap_clear
+	uint8_t replay;
+};
+extern struct bitmap_list_t bitmap_list;
+
 typedef union {
 	uint8_t raw;
 	struct {
@@ -26,29 +142,73 @@ typedef union {
 	} rgb;
 } ColorUnion8;
 
-void bitmap_setparam(uint16_t, uint16_t, uint8_t, uint8_t *_bitmap);
+//_bitmap should be 4 byte aligned (__attribute__((aligned(4)))): unaligned framebuffers and surfaces work, but text takes the slower span path
+void bitmap_setparam(uint16_t, uint16_t, bitmap_color_t, bitmap_color_t *_bitmap);
+void bitmap_setdirect(uint16_t, uint16_t, bitmap_color_t, bitmap_direct_t);
+void bitmap_setlist(uint16_t, uint16_t, bitmap_color_t, bitmap_cmd_t *_list, uint16_t);
+void bitmap_renderBand(bitmap_color_t *_strip, uint16_t, uint16_t);
+
+void bitmap_markDirty(uint16_t, uint16_t, uint16_t, uint16_t);
+void bitmap_clearDirty();
+uint8_t bitmap_pushClip(uint16_t, uint16_t, uint16_t, uint16_t);
+void bitmap_popClip();
 
-void bitmap_pixel(uint16_t, uint16_t, uint8_t);
+void bitmap_pixel(uint16_t, uint16_t, bitmap_color_t);
 void bitmap_clear();
-void bitmap_line(uint16_t, uint16_t, uint16_t, uint16_t, uint8_t);
-void bitmap_bezier(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint8_t);
+void bitmap_line(uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_thickline(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_bezier(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+
+void bitmap_hspan(uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_rect(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_fillrect(uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
 
-void bitmap_rect(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint8_t);
-void bitmap_fillrect(uint16_t, uint16_t, uint16_t, uint16_t, uint8_t);
+void bitmap_circle(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_fillcircle(uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_fillellipse(uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_arc(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_fillarc(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
 
-void bitmap_circle(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint8_t);
-void bitmap_fillcircle(uint16_t, uint16_t, uint16_t, uint16_t, uint8_t);
-void bitmap_arc(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint8_t);
+void bitmap_roundrect(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_fillroundrect(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
 
-void bitmap_roundrect(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint8_t);
-void bitmap_fillroundrect(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint8_t);
+void bitmap_stringBitmap(uint16_t, uint16_t, const char _character[], uint8_t, uint8_t, bitmap_color_t);
+void bitmap_characterBitmap8(uint16_t, uint16_t, char, uint8_t, uint8_t, bitmap_color_t);
+void bitmap_characterBitmap5(uint16_t, uint16_t, char, bitmap_color_t);
+void bitmap_terminal(const char _character[], uint8_t, bitmap_color_t, uint8_t);
+uint8_t bitmap_terminalRing(const char _character[], uint8_t, bitmap_color_t, uint8_t);
+uint16_t bitmap_terminalOffset();
 
-void bitmap_stringBitmap(uint16_t, uint16_t, const char _character[], uint8_t, uint8_t, uint8_t);
-void bitmap_characterBitmap8(uint16_t, uint16_t, char, uint8_t, uint8_t, uint8_t);
-void bitmap_characterBitmap5(uint16_t, uint16_t, char, uint8_t);
-void bitmap_terminal(const char _character[], uint8_t, uint8_t, uint8_t);
+void bitmap_blit(const bitmap_image_t*, uint16_t, uint16_t);
+void bitmap_animation_4bit(const uint8_t* _bitmap, const bitmap_color_t* _color_map, uint16_t, uint16_t, uint16_t, uint16_t);
+uint8_t bitmap_animationOpen(bitmap_animation_t*, const uint8_t*, const bitmap_color_t*, uint16_t, uint16_t);
+uint8_t bitmap_animationNext(bitmap_animation_t*);
+void bitmap_blitSurface(const bitmap_surface_t*, uint16_t, uint16_t);
 
-void bitmap_animation_4bit(const uint8_t* _bitmap, const uint8_t* _color_map, uint16_t, uint16_t, uint16_t, uint16_t);
+//the same primitives drawn into a surface instead of the screen (no dirty rectangles, no display list)
+void bitmap_surfaceInit(bitmap_surface_t*, bitmap_color_t*, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_surfacePixel(bitmap_surface_t*, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_surfaceClear(bitmap_surface_t*);
+void bitmap_surfaceLine(bitmap_surface_t*, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_surfaceThickline(bitmap_surface_t*, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_surfaceBezier(bitmap_surface_t*, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_surfaceHspan(bitmap_surface_t*, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_surfaceRect(bitmap_surface_t*, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_surfaceFillrect(bitmap_surface_t*, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_surfaceCircle(bitmap_surface_t*, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_surfaceFillcircle(bitmap_surface_t*, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_surfaceFillellipse(bitmap_surface_t*, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_surfaceArc(bitmap_surface_t*, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_surfaceFillarc(bitmap_surface_t*, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_surfaceRoundrect(bitmap_surface_t*, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_surfaceFillroundrect(bitmap_surface_t*, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+void bitmap_surfaceStringBitmap(bitmap_surface_t*, uint16_t, uint16_t, const char _character[], uint8_t, uint8_t, bitmap_color_t);
+void bitmap_surfaceCharacterBitmap8(bitmap_surface_t*, uint16_t, uint16_t, char, uint8_t, uint8_t, bitmap_color_t);
+void bitmap_surfaceCharacterBitmap5(bitmap_surface_t*, uint16_t, uint16_t, char, bitmap_color_t);
+void bitmap_surfaceBlit(bitmap_surface_t*, const bitmap_image_t*, uint16_t, uint16_t);
+void bitmap_surfaceBlitSurface(bitmap_surface_t*, const bitmap_surface_t*, uint16_t, uint16_t);
+void bitmap_surfaceAnimation_4bit(bitmap_surface_t*, const uint8_t* _bitmap, const bitmap_color_t* _color_map, uint16_t, uint16_t, uint16_t, uint16_t);
+uint8_t bitmap_surfaceAnimationNext(bitmap_surface_t*, bitmap_animation_t*);
 
 //---------------------------------
 extern const unsigned char FONT8x8[][97][8];
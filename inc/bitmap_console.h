@@ -0,0 +1,42 @@
+/*
+ * bitmap_console.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: k-omura
+ *
+ * Character-cell console: text is kept as cells in a ring of rows, only changed cells are drawn (8x8 font).
+ */
+
+#ifndef INC_BITMAP_CONSOLE_H_
+#define INC_BITMAP_CONSOLE_H_
+
+#include "bitmap.h"
+
+#define CONSOLE_DIRTY_BYTES(cols, rows) ((((cols) * (rows)) + 7) / 8)
+
+typedef struct {
+	char *cells; //cols * rows, rows form a ring starting at origin
+	bitmap_color_t *colors; //color of every cell, NULL: color for all
+	uint8_t *dirty; //one bit per cell position on the screen, CONSOLE_DIRTY_BYTES(cols, rows)
+	uint16_t cols;
+	uint16_t rows;
+	uint16_t origin; //ring row shown at the top
+	uint16_t row; //cursor, 0: top row
+	uint16_t col;
+	uint16_t x; //top left on the screen
+	uint16_t y;
+	uint8_t font;
+	uint8_t ring; //1: rows stay at their ring position on the screen, shown in order with console_scrollOffset() (hardware scrolling)
+	bitmap_color_t color;
+	bitmap_color_t background;
+} console_t;
+
+void console_init(console_t*, char*, bitmap_color_t*, uint8_t*, uint16_t, uint16_t, uint16_t, uint16_t, uint8_t, uint8_t);
+void console_setColor(console_t*, bitmap_color_t, bitmap_color_t);
+void console_print(console_t*, const char*);
+void console_clear(console_t*);
+void console_invalidate(console_t*);
+uint16_t console_render(console_t*);
+uint16_t console_scrollOffset(console_t*);
+
+#endif /* INC_BITMAP_CONSOLE_H_ */
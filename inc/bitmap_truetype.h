@@ -12,9 +12,17 @@
 */
 
 #include "stdio.h"
+#include "stdlib.h"
 #include "string.h"
 #include "bitmap.h"
+
+//0: fonts only from memory (truetype_setTtfMemory), no FatFs needed, e.g. on a PC
+#ifndef TRUETYPE_USE_FATFS
+#define TRUETYPE_USE_FATFS 1
+#endif
+#if TRUETYPE_USE_FATFS
 #include "fatfs.h"
+#endif
 
 #ifndef INC_BITAMAP_TRUETYPE_H_
 #define INC_BITAMAP_TRUETYPE_H_
@@ -28,21 +36,55 @@
 #define ROTATE_180 2
 #define ROTATE_270 3
 
+#ifndef TRUETYPE_CACHE_BLOCKS
+#define TRUETYPE_CACHE_BLOCKS 4 //blocks of the file kept in RAM (LRU), FatFs only
+#endif
+#ifndef TRUETYPE_CACHE_BLOCK_SIZE
+#define TRUETYPE_CACHE_BLOCK_SIZE 512 //bytes per block, one SD sector
+#endif
+#define TRUETYPE_GLYPH_CACHE_ENTRIES 32 //rasterized glyphs kept (LRU)
+#ifndef TRUETYPE_GLYPH_CACHE_BUDGET
+#define TRUETYPE_GLYPH_CACHE_BUDGET 8192 //default bytes for glyph masks, 0: off. truetype_setGlyphCache() changes it
+#endif
+
 //public typedef
+#if TRUETYPE_USE_FATFS
 struct bitmap_truetype_fs_t{
 	FATFS FatFs;
 	FIL File;
 	FRESULT fr;
 };
 extern struct bitmap_truetype_fs_t bitmap_truetype_fs;
+#endif
+
+//block cache counters, can be reset by the application
+struct bitmap_truetype_cache_t{
+	uint32_t hits; //reads served from a cached block
+	uint32_t misses; //blocks read from the file
+	uint32_t prefetches; //blocks read ahead after a sequential miss
+};
+extern struct bitmap_truetype_cache_t bitmap_truetype_cache;
+
+//glyph cache counters, can be reset by the application
+struct bitmap_truetype_glyphCache_t{
+	uint32_t hits; //glyphs drawn from a cached mask
+	uint32_t misses; //glyphs rasterized
+	uint32_t evictions; //masks dropped for the budget
+	uint32_t bytes; //mask bytes in use
+};
+extern struct bitmap_truetype_glyphCache_t bitmap_truetype_glyphCache;
 
 //Assuming "public"
+#if TRUETYPE_USE_FATFS
 uint8_t truetype_setTtfFile(uint8_t);
+#endif
+uint8_t truetype_setTtfMemory(const uint8_t*, size_t);
 void truetype_setCharacterSpacing(int16_t, uint8_t);
 void truetype_setCharacterSize(uint16_t);
 void truetype_setTextBoundary(uint16_t, uint16_t, uint16_t);
-void truetype_setTextColor(uint8_t, uint8_t, uint8_t);
+void truetype_setTextColor(bitmap_color_t, bitmap_color_t, uint8_t);
 void truetype_setTextRotation(uint16_t);
+void truetype_setGlyphCache(uint32_t);
 void truetype_textDrawL(int32_t, int32_t, wchar_t _character[]);
 void truetype_textDraw(int32_t, int32_t, char _character[]);
 uint16_t truetype_getStringWidthL(wchar_t _character[]);
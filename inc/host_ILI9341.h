@@ -0,0 +1,33 @@
+/*
+ * host_ILI9341.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: k-omura
+ *
+ * Memory panel backend for ILI9341_setBackend(). Runs on a PC to profile and check flushes.
+ */
+
+#ifndef DEF_HOST_ILI9341_H
+#define DEF_HOST_ILI9341_H
+
+#include "FSMC_ILI9341.h"
+
+struct host_ILI9341_t{
+	uint16_t gram[ILI9341_PIXEL_COUNT]; //RGB565, in the current rotation
+	uint16_t width; //240, 320 when MADCTL MV is set
+	uint16_t height;
+	//bus transactions (one per command, parameter or pixel write)
+	uint32_t busWrites;
+	uint32_t commands;
+	uint32_t windows;
+	uint32_t pixels;
+	uint32_t frames;
+	const char *dump; //printf format taking the frame number, e.g. "frame%04lu.ppm". NULL: no dump
+};
+extern struct host_ILI9341_t host_ILI9341;
+extern const ILI9341_backend_t host_ILI9341_backend;
+
+void host_ILI9341_resetCount(void);
+uint8_t host_ILI9341_writePPM(const char*);
+
+#endif /* DEF_HOST_ILI9341_H */
@@ -24,7 +24,7 @@
 #define SET_CIRCLRMETER 7
 #define SET_GRAPH 8
 
-void stm32uikit_componentSettings(uint8_t, uint8_t, uint8_t, uint16_t, uint8_t);
+void stm32uikit_componentSettings(bitmap_color_t, bitmap_color_t, bitmap_color_t, uint16_t, uint8_t);
 
 //output
 void stm32uikit_roundProgress(uint16_t, uint16_t, uint16_t, uint16_t);
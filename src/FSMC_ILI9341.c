@@ -10,8 +10,130 @@
 
 //Header files
 #include <FSMC_ILI9341.h>
+#include <bitmap.h>
+#include <string.h>
 
 static uint8_t rotationNum = 1;
+static uint32_t sentPixels = 0;
+
+//display backend: FSMC bus by default, replaceable for profiling off-target
+static void fsmcCommand(uint8_t, const uint8_t*, uint8_t);
+static void fsmcWindow(uint16_t, uint16_t, uint16_t, uint16_t);
+static void fsmcPixels(const uint16_t*, uint32_t);
+static void fsmcFlush(void);
+static const ILI9341_backend_t backendFSMC = {fsmcCommand, fsmcWindow, fsmcPixels, fsmcFlush};
+static const ILI9341_backend_t *backend = &backendFSMC;
+#define PIXEL_CHUNK 64 //RGB332 pixels converted per backend write
+
+//content-diff flush: copy of the last frame sent by ILI9341_printBitmap
+#define DIFF_WORD_PIXELS (4 / sizeof(bitmap_color_t))
+static struct {
+	bitmap_color_t *buf;
+	uint8_t valid;
+} shadow;
+
+//async flush. two line buffers: one is streamed by the transport while the CPU converts the other
+static struct {
+#if BITMAP_COLOR_FORMAT != BITMAP_RGB565
+	uint16_t line[2][ILI9341_ASYNC_LINE_PIXELS];
+#endif
+	const uint16_t *buf[2];
+	uint16_t count[2];
+	uint8_t active;
+	const bitmap_color_t *src;
+	uint32_t left;
+	void (*callback)(void);
+	volatile uint8_t busy;
+	volatile uint8_t pending;
+	volatile uint8_t pumping;
+} async;
+
+static void cpuStart(const uint16_t*, uint16_t);
+static void dmaStart(const uint16_t*, uint16_t);
+static void dmaComplete(DMA_HandleTypeDef*);
+static const ILI9341_transport_t transportCPU = {cpuStart};
+static const ILI9341_transport_t transportDMA = {dmaStart};
+static const ILI9341_transport_t *transport = &transportCPU;
+static DMA_HandleTypeDef *hdmaLCD = NULL;
+
+//tearing effect (TE) synchronized present
+static struct {
+	uint8_t on;
+	uint8_t exti;
+	uint8_t gateReverse;
+	volatile uint32_t count;
+	uint32_t lastPresent;
+	uint32_t missed;
+	uint8_t (*readPin)(void);
+	bitmap_color_t * volatile armed;
+	void (*armedCallback)(void);
+	uint32_t armedTick; //HAL_GetTick() when armed, for ILI9341_TE_TIMEOUT
+} te;
+
+//hardware vertical scroll area, in GRAM lines
+static struct {
+	uint16_t top;
+	uint16_t height;
+} scroll;
+
+//init sequence: command, data count | flags, data..., (delay ms)
+#define INIT_COUNT 0x1f
+#define INIT_ROTATION 0x40 //data is the MADCTL value of the requested rotation
+#define INIT_DELAY 0x80 //one delay byte follows the data
+static const uint8_t initTable[] = {
+	ILI9341_RESET, INIT_DELAY | 0, 100, // software reset
+	ILI9341_DISPLAY_OFF, 0,
+	//------------power control------------------------------
+	ILI9341_POWER1, 1, 0x26, // GVDD = 4.75v
+	ILI9341_POWER2, 1, 0x11, // AVDD=VCIx2, VGH=VCIx7, VGL=-VCIx3
+	//--------------VCOM-------------------------------------
+	ILI9341_VCOM1, 2, 0x35, 0x3e, // VCOMH 4.025v, VCOML -0.950v
+	ILI9341_VCOM2, 1, 0xbe,
+	//------------memory access control------------------------
+	ILI9341_MAC, INIT_ROTATION | 1, 0,
+	ILI9341_PIXEL_FORMAT, 1, 0x55, // 16bit/pixel 16bitColor
+	ILI9341_FRC, 2, 0x00, 0x1F,
+	//-------------ddram ----------------------------
+	ILI9341_COLUMN_ADDR, 4, 0x00, 0x00, 0x00, 0xEF, // 0-239
+	ILI9341_PAGE_ADDR, 4, 0x00, 0x00, 0x01, 0x3F, // 0-319
+	ILI9341_TEARING_OFF, 0,
+	ILI9341_Entry_Mode_Set, 1, 0x07, // deep standby off, normal gate output, low voltage detection off
+	//-----------------display------------------------
+	ILI9341_DFC, 4, 0x0a, 0x82, 0x27, 0x00, // non-display scan, GS/SS/SM, 320 lines, clock divisor
+	ILI9341_SLEEP_OUT, INIT_DELAY | 0, 100,
+	ILI9341_DISPLAY_ON, INIT_DELAY | 0, 100,
+	ILI9341_GRAM, INIT_DELAY | 0, 5,
+};
+
+//MADCTL of rotation 1 to 4
+static const uint8_t madctl[4] = {
+	ILI9341_MADCTL_MY | ILI9341_MADCTL_BGR,
+	ILI9341_MADCTL_MV | ILI9341_MADCTL_BGR,
+	ILI9341_MADCTL_MX | ILI9341_MADCTL_BGR,
+	ILI9341_MADCTL_MX | ILI9341_MADCTL_MY | ILI9341_MADCTL_MV | ILI9341_MADCTL_BGR
+};
+
+static struct {
+	uint16_t pos; //next initTable byte
+	uint8_t rotation;
+	uint8_t waiting;
+	uint8_t delay;
+	uint32_t start;
+} initState = {sizeof(initTable), 1, 0, 0, 0};
+
+static void setFrameRect(void);
+static void pushRect(uint16_t, uint16_t, uint16_t, uint16_t);
+static void sendPixels(const bitmap_color_t*, uint32_t);
+static void diffFlush(const bitmap_color_t*);
+static uint32_t diffWord(const bitmap_color_t*);
+static uint8_t scrollMirrored(void);
+static void setGateScan(uint8_t);
+static void busWait(void);
+static void armedWait(void);
+static void presentStart(bitmap_color_t*, void (*)(void), uint8_t);
+static void asyncStart(bitmap_color_t*, void (*)(void), uint8_t);
+static void asyncConvert(uint8_t);
+static void asyncPump(void);
 
 //***** Functions *****//
 void ILI9341_sendCommand16(uint16_t _cmd) {
@@ -30,108 +152,644 @@ void ILI9341_sendData8(uint8_t _data) {
 	*(volatile uint16_t*) LCD_ADDR_DATA = (uint16_t) _data;
 }
 
+//blocking init, rotation 1
 void ILI9341_init(void) {
-	ILI9341_sendCommand8(ILI9341_RESET); // software reset command
-	HAL_Delay(100);
-	ILI9341_sendCommand8(ILI9341_DISPLAY_OFF); // display off
-	//------------power control------------------------------
-	ILI9341_sendCommand8(ILI9341_POWER1); // power control
-	ILI9341_sendData8(0x26); // GVDD = 4.75v
-	ILI9341_sendCommand8(ILI9341_POWER2); // power control
-	ILI9341_sendData8(0x11); // AVDD=VCIx2, VGH=VCIx7, VGL=-VCIx3
-	//--------------VCOM-------------------------------------
-	ILI9341_sendCommand8(ILI9341_VCOM1); // vcom control
-	ILI9341_sendData8(0x35); // Set the VCOMH voltage (0x35 = 4.025v)
-	ILI9341_sendData8(0x3e); // Set the VCOML voltage (0x3E = -0.950v)
-	ILI9341_sendCommand8(ILI9341_VCOM2); // vcom control
-	ILI9341_sendData8(0xbe);
+	ILI9341_initStart(1);
+	while (!ILI9341_initPoll());
+}
 
-	//------------memory access control------------------------
-	ILI9341_sendCommand8(ILI9341_MAC); // memory access control
-	ILI9341_sendData8(0x48);
+/*
+ * Non-blocking init. ILI9341_initStart() starts the initTable sequence, ILI9341_initPoll() sends
+ * commands until the next delay and returns 1 once the panel is ready (HAL_GetTick based).
+ * Nothing else may be sent to the LCD until then; rendering into the framebuffer is fine.
+ */
+void ILI9341_initStart(uint8_t _rotate) {
+	if ((_rotate < 1) || (_rotate > 4)) {
+		_rotate = 1;
+	}
+	initState.pos = 0;
+	initState.rotation = _rotate;
+	initState.waiting = 0;
+}
 
-	ILI9341_sendCommand8(ILI9341_PIXEL_FORMAT); // pixel format set
-	ILI9341_sendData8(0x55); // 16bit/pixel 16bitColor
+uint8_t ILI9341_initPoll(void) {
+	while (1) {
+		if (initState.waiting) {
+			if ((HAL_GetTick() - initState.start) < initState.delay) {
+				return 0;
+			}
+			initState.waiting = 0;
+		}
+		if (initState.pos >= sizeof(initTable)) {
+			return 1;
+		}
 
-	ILI9341_sendCommand8(ILI9341_FRC);
-	ILI9341_sendData8(0);
-	ILI9341_sendData8(0x1F);
-	//-------------ddram ----------------------------
-	ILI9341_sendCommand8(ILI9341_COLUMN_ADDR); // column set
-	ILI9341_sendData8(0x00); // x0_HIGH---0
-	ILI9341_sendData8(0x00); // x0_LOW----0
-	ILI9341_sendData8(0x00); // x1_HIGH---240
-	ILI9341_sendData8(0xEF); // x1_LOW----240
-	ILI9341_sendCommand8(ILI9341_PAGE_ADDR); // page address set
-	ILI9341_sendData8(0x00); // y0_HIGH---0
-	ILI9341_sendData8(0x00); // y0_LOW----0
-	ILI9341_sendData8(0x01); // y1_HIGH---320
-	ILI9341_sendData8(0x3F); // y1_LOW----320
-
-	ILI9341_sendCommand8(ILI9341_TEARING_OFF); // tearing effect off
-	//LCD_write_cmd(ILI9341_TEARING_ON); // tearing effect on
-	//LCD_write_cmd(ILI9341_DISPLAY_INVERSION); // display inversion
-	ILI9341_sendCommand8(ILI9341_Entry_Mode_Set); // entry mode set
-	// Deep Standby Mode: OFF
-	// Set the output level of gate driver G1-G320: Normal display
-	// Low voltage detection: Disable
-	ILI9341_sendData8(0x07);
-	//-----------------display------------------------
-	ILI9341_sendCommand8(ILI9341_DFC); // display function control
-	//Set the scan mode in non-display area
-	//Determine source/VCOM output in a non-display area in the partial display mode
-	ILI9341_sendData8(0x0a);
-	//Select whether the liquid crystal type is normally white type or normally black type
-	//Sets the direction of scan by the gate driver in the range determined by SCN and NL
-	//Select the shift direction of outputs from the source driver
-	//Sets the gate driver pin arrangement in combination with the GS bit to select the optimal scan mode for the module
-	//Specify the scan cycle interval of gate driver in non-display area when PTG to select interval scan
-	ILI9341_sendData8(0x82);
-	// Sets the number of lines to drive the LCD at an interval of 8 lines
-	ILI9341_sendData8(0x27);
-	ILI9341_sendData8(0x00); // clock divisor
-
-	ILI9341_sendCommand8(ILI9341_SLEEP_OUT); // sleep out
-	HAL_Delay(100);
-	ILI9341_sendCommand8(ILI9341_DISPLAY_ON); // display on
-	HAL_Delay(100);
-	ILI9341_sendCommand8(ILI9341_GRAM); // memory write
-	HAL_Delay(5);
+		const uint8_t *p = &initTable[initState.pos];
+		uint8_t count = p[1] & INIT_COUNT;
+		if (p[1] & INIT_ROTATION) {
+			backend->command(p[0], &madctl[initState.rotation - 1], 1);
+		} else {
+			backend->command(p[0], &p[2], count);
+		}
+		initState.pos += 2 + count;
+
+		if (p[0] == ILI9341_MAC) {
+			rotationNum = initState.rotation;
+		} else if (p[0] == ILI9341_DFC) {
+			te.gateReverse = 0;
+		} else if (p[0] == ILI9341_TEARING_OFF) {
+			te.on = 0;
+		}
+
+		if (p[1] & INIT_DELAY) {
+			initState.delay = initTable[initState.pos++];
+			initState.start = HAL_GetTick();
+			initState.waiting = 1;
+		}
+	}
 }
 
 void ILI9341_setRotation(uint8_t _rotate) {
-	switch (_rotate) {
-	case 1:
-		rotationNum = 1;
-		ILI9341_sendCommand8(ILI9341_MEMCONTROL);
-		ILI9341_sendData8(ILI9341_MADCTL_MY | ILI9341_MADCTL_BGR);
-		break;
-	case 2:
-		rotationNum = 2;
-		ILI9341_sendCommand8(ILI9341_MEMCONTROL);
-		ILI9341_sendData8(ILI9341_MADCTL_MV | ILI9341_MADCTL_BGR);
-		break;
-	case 3:
-		rotationNum = 3;
-		ILI9341_sendCommand8(ILI9341_MEMCONTROL);
-		ILI9341_sendData8(ILI9341_MADCTL_MX | ILI9341_MADCTL_BGR);
-		break;
-	case 4:
-		rotationNum = 4;
-		ILI9341_sendCommand8(ILI9341_MEMCONTROL);
-		ILI9341_sendData8(
-				ILI9341_MADCTL_MX | ILI9341_MADCTL_MY | ILI9341_MADCTL_MV
-						| ILI9341_MADCTL_BGR);
-		break;
-	default:
-		rotationNum = 1;
-		ILI9341_sendCommand8(ILI9341_MEMCONTROL);
-		ILI9341_sendData8(ILI9341_MADCTL_MY | ILI9341_MADCTL_BGR);
-		break;
+	busWait();
+	shadow.valid = 0;
+	if ((_rotate < 1) || (_rotate > 4)) {
+		_rotate = 1;
 	}
+	rotationNum = _rotate;
+
+	if ((_rotate == 1) && te.on) {
+		//same picture as MY, but GRAM is written in gate scan order
+		const uint8_t gs = ILI9341_MADCTL_BGR;
+		setGateScan(1);
+		backend->command(ILI9341_MEMCONTROL, &gs, 1);
+		return;
+	}
+	setGateScan(0);
+	backend->command(ILI9341_MEMCONTROL, &madctl[_rotate - 1], 1);
+}
+
+//GS bit of display function control. reverse: gate scan G320 -> G1
+static void setGateScan(uint8_t _reverse) {
+	if (te.gateReverse == _reverse) {
+		return;
+	}
+	te.gateReverse = _reverse;
+	uint8_t data[4] = {0x0a, (_reverse) ? (0xc2) : (0x82), 0x27, 0x00};
+	backend->command(ILI9341_DFC, data, 4);
 }
 
 void ILI9341_setRect(uint16_t _x1, uint16_t _y1, uint16_t _x2, uint16_t _y2) {
+	busWait();
+	backend->window(_x1, _y1, _x2, _y2);
+}
+
+static void setFrameRect(void) {
+	if (rotationNum == 1 || rotationNum == 3) {
+		ILI9341_setRect(0, 0, ILI9341_WIDTH - 1, ILI9341_HEIGHT - 1);
+	} else if (rotationNum == 2 || rotationNum == 4) {
+		ILI9341_setRect(0, 0, ILI9341_HEIGHT - 1, ILI9341_WIDTH - 1);
+	}
+}
+
+void ILI9341_printBitmap(bitmap_color_t *_data) {
+	busWait();
+	if (shadow.valid) {
+		diffFlush(_data);
+	} else {
+		setFrameRect();
+		sendPixels(_data, ILI9341_PIXEL_COUNT);
+		if (shadow.buf != NULL) {
+			memcpy(shadow.buf, _data, ILI9341_PIXEL_COUNT * sizeof(bitmap_color_t));
+			shadow.valid = 1;
+		}
+	}
+	backend->flush();
+
+	if (_data == bitmap_param.bitmap) {
+		bitmap_clearDirty();
+	}
+}
+
+/* Flush only the merged damaged rectangles recorded by the bitmap_* primitives */
+void ILI9341_flushDirty(void) {
+	if ((bitmap_param.width == 0) || (bitmap_param.bitmap == NULL)) {
+		return;
+	}
+
+	for (uint8_t i = 0; i < bitmap_dirty.count; i++) {
+		bitmap_rect_t *r = &bitmap_dirty.rect[i];
+		pushRect(r->x0, r->y0, r->x1, r->y1);
+	}
+	bitmap_clearDirty();
+	backend->flush();
+}
+
+//send a rectangle of the bitmap_param framebuffer
+static void pushRect(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1) {
+	uint16_t w = _x1 - _x0 + 1;
+
+	ILI9341_setRect(_x0, _y0, _x1, _y1);
+	for (uint16_t y = _y0; y <= _y1; y++) {
+		uint32_t offset = (uint32_t) y * bitmap_param.width + _x0;
+		sendPixels(&bitmap_param.bitmap[offset], w);
+		if (shadow.valid) {
+			memcpy(&shadow.buf[offset], &bitmap_param.bitmap[offset], w * sizeof(bitmap_color_t));
+		}
+	}
+}
+
+/*
+ * Content-diff flush. With a shadow buffer (ILI9341_PIXEL_COUNT pixels) set,
+ * ILI9341_printBitmap compares each row with the last sent frame and sends only the changed spans.
+ * Useful when the whole screen is redrawn every frame. NULL turns it off.
+ */
+void ILI9341_setShadow(bitmap_color_t *_shadow) {
+	shadow.buf = _shadow;
+	shadow.valid = 0;
+}
+
+static void diffFlush(const bitmap_color_t *_data) {
+	uint16_t w = ((rotationNum == 2) || (rotationNum == 4)) ? ILI9341_HEIGHT : ILI9341_WIDTH;
+	uint16_t h = ILI9341_PIXEL_COUNT / w;
+	uint16_t words = w / DIFF_WORD_PIXELS;
+	//window left open by the previous span. rows with the same span continue it without a new setRect
+	uint16_t open_x0 = 0xffff;
+	uint16_t open_x1 = 0xffff;
+	uint16_t next_y = 0xffff;
+
+	for (uint16_t y = 0; y < h; y++) {
+		uint32_t row = (uint32_t) y * w;
+		const bitmap_color_t *a = &_data[row];
+		const bitmap_color_t *b = &shadow.buf[row];
+
+		uint16_t i = 0;
+		while (i < words) {
+			if (diffWord(&a[i * DIFF_WORD_PIXELS]) == diffWord(&b[i * DIFF_WORD_PIXELS])) {
+				i++;
+				continue;
+			}
+
+			//changed span, bridging unchanged gaps shorter than ILI9341_DIFF_GAP
+			uint16_t start = i;
+			uint16_t end = i;
+			uint16_t gap = 0;
+			for (i++; i < words; i++) {
+				if (diffWord(&a[i * DIFF_WORD_PIXELS]) != diffWord(&b[i * DIFF_WORD_PIXELS])) {
+					end = i;
+					gap = 0;
+				} else if ((++gap * DIFF_WORD_PIXELS) >= ILI9341_DIFF_GAP) {
+					break;
+				}
+			}
+
+			uint16_t x0 = start * DIFF_WORD_PIXELS;
+			uint16_t x1 = (end + 1) * DIFF_WORD_PIXELS - 1;
+			if ((x0 != open_x0) || (x1 != open_x1) || (y != next_y)) {
+				ILI9341_setRect(x0, y, x1, h - 1);
+				open_x0 = x0;
+				open_x1 = x1;
+			}
+			next_y = y + 1;
+
+			sendPixels(&_data[row + x0], x1 - x0 + 1);
+			memcpy(&shadow.buf[row + x0], &_data[row + x0], (x1 - x0 + 1) * sizeof(bitmap_color_t));
+		}
+	}
+}
+
+//4 bytes of pixels. memcpy: neither buffer has to be word aligned, and it compiles to a single load
+static uint32_t diffWord(const bitmap_color_t *_p) {
+	uint32_t word;
+	memcpy(&word, _p, sizeof(word));
+	return word;
+}
+
+//write pixels to the open window
+static void sendPixels(const bitmap_color_t *_src, uint32_t _count) {
+	sentPixels += _count;
+#if BITMAP_COLOR_FORMAT == BITMAP_RGB565
+	backend->pixels(_src, _count);
+#else
+	uint16_t chunk[PIXEL_CHUNK];
+	while (_count) {
+		uint32_t n = (_count < PIXEL_CHUNK) ? _count : PIXEL_CHUNK;
+		for (uint32_t i = 0; i < n; i++) {
+			chunk[i] = col8to16[_src[i]];
+		}
+		backend->pixels(chunk, n);
+		_src += n;
+		_count -= n;
+	}
+#endif
+}
+
+/*
+ * Banded flush of the display list (bitmap_setlist). The screen is rendered _lines rows at a time
+ * into _strip (bitmap_param.width * _lines pixels) and each band is sent as one window.
+ */
+void ILI9341_printList(bitmap_color_t *_strip, uint16_t _lines) {
+	if ((bitmap_list.cmd == NULL) || (_lines == 0)) {
+		return;
+	}
+	shadow.valid = 0;
+
+	for (uint16_t y = 0; y < bitmap_param.height; y += _lines) {
+		uint16_t lines = ((bitmap_param.height - y) < _lines) ? (bitmap_param.height - y) : _lines;
+		bitmap_renderBand(_strip, y, lines);
+		ILI9341_setRect(0, y, bitmap_param.width - 1, y + lines - 1);
+		sendPixels(_strip, (uint32_t) bitmap_param.width * lines);
+	}
+	backend->flush();
+}
+
+/*
+ * Fill a rectangle straight into GRAM: one window and a burst of the same pixel.
+ * Direct rendering target for bitmap_setdirect(), no framebuffer needed.
+ */
+void ILI9341_fillRect(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, bitmap_color_t _color) {
+#if BITMAP_COLOR_FORMAT == BITMAP_RGB565
+	uint16_t color = _color;
+#else
+	uint16_t color = col8to16[_color];
+#endif
+	uint32_t pixels = (uint32_t) (_x1 - _x0 + 1) * (_y1 - _y0 + 1);
+	uint16_t chunk[PIXEL_CHUNK];
+	for (uint8_t i = 0; i < PIXEL_CHUNK; i++) {
+		chunk[i] = color;
+	}
+
+	shadow.valid = 0;
+	ILI9341_setRect(_x0, _y0, _x1, _y1);
+	sentPixels += pixels;
+	while (pixels) {
+		uint32_t n = (pixels < PIXEL_CHUNK) ? pixels : PIXEL_CHUNK;
+		backend->pixels(chunk, n);
+		pixels -= n;
+	}
+}
+
+/*
+ * Hardware vertical scrolling (portrait rotations 1 and 3).
+ * Area and offset are given in framebuffer rows. The panel scrolls GRAM lines, so the area is
+ * mirrored when rows are written bottom-up (rotation 1 without TE sync).
+ */
+void ILI9341_setScrollArea(uint16_t _top, uint16_t _height) {
+	if ((rotationNum == 2) || (rotationNum == 4) || ((_top + _height) > ILI9341_HEIGHT)) {
+		return;
+	}
+	uint16_t bottom = ILI9341_HEIGHT - _top - _height;
+	if (scrollMirrored()) {
+		uint16_t tmp = _top;
+		_top = bottom;
+		bottom = tmp;
+	}
+	scroll.top = _top;
+	scroll.height = _height;
+
+	busWait();
+	uint8_t data[6] = {_top >> 8, _top & 0xFF, _height >> 8, _height & 0xFF, bottom >> 8, bottom & 0xFF};
+	backend->command(ILI9341_VERTICAL_SCROLL, data, 6);
+}
+
+//show the scroll area starting _offset rows further down. 0 restores the normal picture
+void ILI9341_setScrollOffset(uint16_t _offset) {
+	if ((rotationNum == 2) || (rotationNum == 4) || (scroll.height == 0)) {
+		return;
+	}
+	_offset %= scroll.height;
+	if (scrollMirrored()) {
+		_offset = (scroll.height - _offset) % scroll.height;
+	}
+	uint16_t start = scroll.top + _offset;
+
+	busWait();
+	uint8_t data[2] = {start >> 8, start & 0xFF};
+	backend->command(ILI9341_VERTICAL_SCROLL_START, data, 2);
+}
+
+/*
+ * Terminal with hardware scrolling: the new line is written into the framebuffer ring (bitmap_terminalRing),
+ * only those 8 rows are sent, and the scroll start address is moved instead of redrawing the terminal.
+ * Landscape rotations cannot scroll vertically and fall back to bitmap_terminal and a flush of the terminal rows.
+ */
+void ILI9341_terminal(const char _character[], uint8_t _font, bitmap_color_t _color, uint8_t _max_line) {
+	if ((bitmap_param.width == 0) || (_max_line == 0)) {
+		return;
+	}
+
+	if ((rotationNum == 2) || (rotationNum == 4)) {
+		bitmap_terminal(_character, _font, _color, _max_line);
+		pushRect(0, 0, bitmap_param.width - 1, (8 * _max_line) - 1);
+		return;
+	}
+
+	ILI9341_setScrollArea(0, 8 * _max_line);
+	uint8_t line = bitmap_terminalRing(_character, _font, _color, _max_line);
+	pushRect(0, line * 8, bitmap_param.width - 1, line * 8 + 7);
+	ILI9341_setScrollOffset(bitmap_terminalOffset());
+}
+
+//GRAM lines run opposite to framebuffer rows
+static uint8_t scrollMirrored(void) {
+	return (rotationNum == 1) && !te.gateReverse;
+}
+
+/*
+ * Asynchronous flush.
+ * The framebuffer is converted through col8to16 into two small line buffers.
+ * The transport streams one buffer to LCD_ADDR_DATA while the next one is converted.
+ * A RGB565 framebuffer needs no conversion and is streamed in place.
+ * _callback is called (from the transport completion context) when the whole frame has been sent.
+ * Do not draw into the framebuffer until ILI9341_isBusy() returns 0.
+ */
+void ILI9341_printBitmapAsync(bitmap_color_t *_data, void (*_callback)(void)) {
+	busWait();
+	asyncStart(_data, _callback, 0);
+}
+
+//_prepared: the shadow copy and dirty reset were done by ILI9341_presentOnTe, not in the TE interrupt
+static void asyncStart(bitmap_color_t *_data, void (*_callback)(void), uint8_t _prepared) {
+	setFrameRect();
+
+	async.src = _data;
+	async.left = ILI9341_PIXEL_COUNT;
+	async.callback = _callback;
+	async.count[0] = 0;
+	async.count[1] = 0;
+	async.pending = 0;
+	async.busy = 1;
+	if (!_prepared) {
+		if (_data == bitmap_param.bitmap) {
+			bitmap_clearDirty();
+		}
+		if (shadow.buf != NULL) {
+			memcpy(shadow.buf, _data, ILI9341_PIXEL_COUNT * sizeof(bitmap_color_t));
+			shadow.valid = 1;
+		}
+	}
+
+	asyncConvert(0);
+	asyncConvert(1);
+
+	async.pumping = 1;
+	async.active = 0;
+	transport->start(async.buf[0], async.count[0]);
+	asyncPump();
+}
+
+uint8_t ILI9341_isBusy(void) {
+	return async.busy || (te.armed != NULL);
+}
+
+//every bus path waits here: an armed frame would otherwise start from the TE interrupt in the middle of its commands
+static void busWait(void) {
+	armedWait();
+	while (async.busy);
+}
+
+//wait until the armed frame has been started. without a TE edge within ILI9341_TE_TIMEOUT it is dropped
+static void armedWait(void) {
+	while (te.armed != NULL) {
+		if ((HAL_GetTick() - te.armedTick) > ILI9341_TE_TIMEOUT) {
+			__disable_irq();
+			if (te.armed != NULL) {
+				te.armed = NULL;
+				te.missed++;
+			}
+			__enable_irq();
+		}
+	}
+}
+
+//Called by the transport when the buffer passed to start() has been written out. ISR safe.
+void ILI9341_transferComplete(void) {
+	async.pending = 1;
+	if (async.pumping) {
+		return; //picked up by the running pump
+	}
+	async.pumping = 1;
+	asyncPump();
+}
+
+void ILI9341_setTransport(const ILI9341_transport_t *_transport) {
+	busWait();
+	transport = (_transport == NULL) ? (&transportCPU) : (_transport);
+}
+
+/*
+ * DMA2 memory-to-memory transport.
+ * Stream settings: MEMORY_TO_MEMORY, source(peripheral) increment ON, destination(memory) increment OFF,
+ * half-word alignment on both sides, FIFO enabled, normal mode, interrupt enabled.
+ * Line buffers have to be in DMA accessible SRAM (not CCM).
+ */
+void ILI9341_dmaInit(DMA_HandleTypeDef *_hdma) {
+	hdmaLCD = _hdma;
+	hdmaLCD->XferCpltCallback = dmaComplete;
+	ILI9341_setTransport(&transportDMA);
+}
+
+static void asyncConvert(uint8_t _index) {
+	uint16_t n = (async.left > ILI9341_ASYNC_LINE_PIXELS) ? (ILI9341_ASYNC_LINE_PIXELS) : (async.left);
+
+#if BITMAP_COLOR_FORMAT == BITMAP_RGB565
+	async.buf[_index] = async.src;
+#else
+	uint16_t *dst = async.line[_index];
+	const uint8_t *src = async.src;
+
+	for (uint16_t i = 0; i < n; i++) {
+		dst[i] = col8to16[src[i]];
+	}
+	async.buf[_index] = dst;
+#endif
+	async.src += n;
+	async.left -= n;
+	async.count[_index] = n;
+}
+
+static void asyncPump(void) {
+	while (1) {
+		__disable_irq();
+		if (!async.pending) {
+			async.pumping = 0;
+			__enable_irq();
+			return;
+		}
+		async.pending = 0;
+		__enable_irq();
+
+		uint8_t done = async.active;
+		uint8_t next = done ^ 1;
+		sentPixels += async.count[done];
+		async.count[done] = 0;
+
+		if (async.count[next] == 0) {
+			backend->flush();
+			async.busy = 0;
+			async.pumping = 0;
+			if (async.callback != NULL) {
+				async.callback();
+			}
+			return;
+		}
+
+		async.active = next;
+		transport->start(async.buf[next], async.count[next]);
+		if (async.left) {
+			asyncConvert(done);
+		}
+	}
+}
+
+//blocking fallback when no DMA is configured
+static void cpuStart(const uint16_t *_src, uint16_t _count) {
+	backend->pixels(_src, _count);
+	ILI9341_transferComplete();
+}
+
+static void dmaStart(const uint16_t *_src, uint16_t _count) {
+	if (HAL_DMA_Start_IT(hdmaLCD, (uint32_t) _src, (uint32_t) LCD_ADDR_DATA, _count) != HAL_OK) {
+		ILI9341_transferComplete(); //drop the line rather than stall
+	}
+}
+
+static void dmaComplete(DMA_HandleTypeDef *_hdma) {
+	if (_hdma != hdmaLCD) {
+		return;
+	}
+	ILI9341_transferComplete();
+}
+
+/*
+ * Tearing effect synchronized present.
+ * ILI9341_setTearing(1) enables the TE output (V-blanking only). In portrait rotation 1 the MY flip is replaced
+ * by a reversed gate scan, so GRAM is written in the same order the panel scans it and the write pointer,
+ * started at the TE edge, stays behind the scan line. Rotation 3 already scans in write order.
+ * Landscape rotations (2, 4) write across the scan direction and are only paced, not tear-free.
+ *
+ * TE edge sources:
+ *  EXTI: call ILI9341_teIrq() from the rising edge interrupt of the TE pin. Enables ILI9341_presentOnTe()
+ *        and exact missed-vsync counting. The interrupt only sets the window and starts the DMA transport
+ *        (ILI9341_dmaInit); with the CPU transport ILI9341_presentOnTe() falls back to ILI9341_presentSync().
+ *  Polling: ILI9341_setTeHook() with a function returning the TE pin level. ILI9341_presentSync() polls it.
+ */
+void ILI9341_setTearing(uint8_t _on) {
+	busWait();
+	if (_on) {
+		const uint8_t mode = 0x00; //V-blanking information only
+		backend->command(ILI9341_TEARING_ON, &mode, 1);
+	} else {
+		backend->command(ILI9341_TEARING_OFF, NULL, 0);
+	}
+	te.on = _on;
+	ILI9341_setRotation(rotationNum);
+}
+
+void ILI9341_setTeHook(uint8_t (*_readPin)(void)) {
+	te.readPin = _readPin;
+}
+
+void ILI9341_teIrq(void) {
+	te.exti = 1;
+	te.count++;
+
+	if ((te.armed == NULL) || async.busy) {
+		return; //nothing to show, or the previous frame is still being written. retry on the next edge
+	}
+	bitmap_color_t *data = te.armed;
+	te.armed = NULL;
+	presentStart(data, te.armedCallback, 1);
+}
+
+//wait for the next TE edge, then start the flush. returns 1 if no edge arrived within ILI9341_TE_TIMEOUT
+uint8_t ILI9341_presentSync(bitmap_color_t *_data, void (*_callback)(void)) {
+	uint8_t timeout = 0;
+
+	busWait();
+	uint32_t start = HAL_GetTick();
+
+	if (te.exti) {
+		uint32_t count = te.count;
+		while (te.count == count) {
+			if ((HAL_GetTick() - start) > ILI9341_TE_TIMEOUT) {
+				timeout = 1;
+				break;
+			}
+		}
+	} else if (te.readPin != NULL) {
+		//skip the pulse in progress, then catch the rising edge
+		while (te.readPin() && !timeout) {
+			timeout = ((HAL_GetTick() - start) > ILI9341_TE_TIMEOUT);
+		}
+		while (!te.readPin() && !timeout) {
+			timeout = ((HAL_GetTick() - start) > ILI9341_TE_TIMEOUT);
+		}
+		te.count++;
+	}
+
+	presentStart(_data, _callback, 0);
+	return timeout;
+}
+
+/*
+ * Arm a frame. The flush is started from ILI9341_teIrq() on the next TE edge; until then ILI9341_isBusy()
+ * returns 1 and the other ILI9341_* calls wait. If no edge arrives within ILI9341_TE_TIMEOUT, the frame is
+ * dropped (not sent, no callback) and counted as a missed vsync.
+ * Needs the DMA transport, TE on and edges from ILI9341_teIrq(): the CPU transport would write the whole
+ * frame inside the interrupt, and without edges nothing would start it, so ILI9341_presentSync() is used instead.
+ */
+void ILI9341_presentOnTe(bitmap_color_t *_data, void (*_callback)(void)) {
+	if ((transport == &transportCPU) || !te.on || !te.exti) {
+		ILI9341_presentSync(_data, _callback);
+		return;
+	}
+	armedWait();
+
+	//done here rather than in the interrupt
+	if (_data == bitmap_param.bitmap) {
+		bitmap_clearDirty();
+	}
+	if (shadow.buf != NULL) {
+		memcpy(shadow.buf, _data, ILI9341_PIXEL_COUNT * sizeof(bitmap_color_t));
+		shadow.valid = 1;
+	}
+	te.armedCallback = _callback;
+	te.armedTick = HAL_GetTick();
+	te.armed = _data;
+}
+
+//TE periods that passed without a new frame being presented
+uint32_t ILI9341_getMissedVsync(void) {
+	return te.missed;
+}
+
+static void presentStart(bitmap_color_t *_data, void (*_callback)(void), uint8_t _prepared) {
+	uint32_t elapsed = te.count - te.lastPresent;
+	if ((te.lastPresent != 0) && (elapsed > 1)) {
+		te.missed += elapsed - 1;
+	}
+	te.lastPresent = te.count;
+	asyncStart(_data, _callback, _prepared);
+}
+
+/*
+ * Replace the bus the driver talks to (NULL: FSMC). Commands, windows and pixels of every
+ * synchronous path and of the CPU transport go through it; the DMA transport always uses FSMC.
+ */
+void ILI9341_setBackend(const ILI9341_backend_t *_backend) {
+	busWait();
+	backend = (_backend != NULL) ? _backend : &backendFSMC;
+	shadow.valid = 0;
+}
+
+static void fsmcCommand(uint8_t _cmd, const uint8_t *_data, uint8_t _count) {
+	ILI9341_sendCommand8(_cmd);
+	for (uint8_t i = 0; i < _count; i++) {
+		ILI9341_sendData8(_data[i]);
+	}
+}
+
+static void fsmcWindow(uint16_t _x1, uint16_t _y1, uint16_t _x2, uint16_t _y2) {
 	ILI9341_sendCommand8(ILI9341_COLUMN_ADDR);
 	ILI9341_sendData8(_x1 >> 8);
 	ILI9341_sendData8(_x1 & 0xFF);
@@ -146,16 +804,22 @@ void ILI9341_setRect(uint16_t _x1, uint16_t _y1, uint16_t _x2, uint16_t _y2) {
 	ILI9341_sendCommand8(ILI9341_GRAM);
 }
 
-void ILI9341_printBitmap(uint8_t *_data) {
-	if (rotationNum == 1 || rotationNum == 3) {
-		ILI9341_setRect(0, 0, ILI9341_WIDTH - 1, ILI9341_HEIGHT - 1);
-	} else if (rotationNum == 2 || rotationNum == 4) {
-		ILI9341_setRect(0, 0, ILI9341_HEIGHT - 1, ILI9341_WIDTH - 1);
+static void fsmcPixels(const uint16_t *_src, uint32_t _count) {
+	for (uint32_t i = 0; i < _count; i++) {
+		ILI9341_sendData16(_src[i]);
 	}
+}
 
-	for (uint32_t i = 0; i < ILI9341_PIXEL_COUNT; i++) {
-		ILI9341_sendData16(col8to16[_data[i]]);
-	}
+static void fsmcFlush(void) {
+}
+
+//number of pixels pushed to GRAM since the last reset
+uint32_t ILI9341_getSentPixels(void) {
+	return sentPixels;
+}
+
+void ILI9341_resetSentPixels(void) {
+	sentPixels = 0;
 }
 
 const uint16_t col8to16[256] = {0b0000000000000000,
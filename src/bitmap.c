@@ -6,42 +6,593 @@
  */
 
 #include "bitmap.h"
+#include <string.h>
 
 struct bitmap_param_t bitmap_param = {0, 0, 0, 0};
+struct bitmap_dirty_t bitmap_dirty = {0};
 uint16_t term_line = 0;
+uint16_t term_top = 0; //ring terminal: framebuffer line shown at the top
+static bitmap_direct_t direct = NULL; //used when there is no framebuffer
+struct bitmap_list_t bitmap_list = {NULL, 0, 0, 0, 0};
+//rows held by bitmap_param.bitmap: the whole screen, or one band while the display list is replayed
+static uint16_t view_top = 0;
+static uint16_t view_lines = 0;
+static uint16_t stride = 0; //pixels from one row of bitmap_param.bitmap to the next
+static const bitmap_surface_t *surface = NULL; //bound by a bitmap_surface* call: no dirty rectangles, no recording
+
+enum {
+	CMD_PIXEL,
+	CMD_LINE,
+	CMD_THICKLINE,
+	CMD_RECT,
+	CMD_FILLRECT,
+	CMD_CIRCLE,
+	CMD_FILLCIRCLE,
+	CMD_FILLELLIPSE,
+	CMD_ARC,
+	CMD_FILLARC,
+	CMD_ROUNDRECT,
+	CMD_FILLROUNDRECT,
+	CMD_CHARACTER8,
+	CMD_CHARACTER5,
+	CMD_ANIMATION4,
+	CMD_BLIT,
+	CMD_BLITSURFACE,
+	CMD_PUSHCLIP,
+	CMD_POPCLIP
+};
+
+typedef struct {
+	int32_t x0;
+	int32_t y0;
+	int32_t x1;
+	int32_t y1;
+} clipRect_t;
+
+//clip rectangle stack (bitmap_pushClip), screen coordinates. x0 > x1 or y0 > y1: nothing is drawn
+static struct clip_t {
+	clipRect_t rect;
+	clipRect_t stack[BITMAP_CLIP_DEPTH];
+	uint8_t depth;
+} clip;
+//clip rectangle limited to the rows held by bitmap_param.bitmap: every span is clipped against this
+static clipRect_t win;
+
+//drawing target replaced while a bitmap_surface* call draws
+struct target_t {
+	struct bitmap_param_t param;
+	bitmap_direct_t direct;
+	const bitmap_surface_t *surface;
+	uint16_t stride;
+	uint16_t view_top;
+	uint16_t view_lines;
+	clipRect_t clip;
+	uint8_t depth;
+};
+
+static void dirtyAdd(int32_t, int32_t, int32_t, int32_t);
+static void dirtyBegin(int32_t, int32_t, int32_t, int32_t);
+static void dirtyEnd();
+static uint8_t surfaceBegin(bitmap_surface_t*, struct target_t*);
+static void surfaceEnd(const struct target_t*);
+static void clipReset();
+static void clipUpdate();
+static uint8_t clipReject(int32_t, int32_t, int32_t, int32_t);
+static uint8_t outcode(int32_t, int32_t);
+static uint32_t lineSteps(uint32_t, int32_t, int32_t, int32_t*);
+static uint32_t lineFirst(uint32_t, int32_t, int32_t, int32_t);
+static void lineAxis(int32_t, int32_t, int32_t, int32_t, int32_t*, int32_t*);
+static void terminalLine(const char _character[], uint8_t, bitmap_color_t, uint16_t);
+static void directRect(int32_t, int32_t, int32_t, int32_t, bitmap_color_t);
+static void hspan(uint16_t, uint16_t, uint16_t, bitmap_color_t);
+static void vspan(uint16_t, uint16_t, uint16_t, bitmap_color_t);
+static void fill(uint16_t, uint16_t, uint16_t, uint16_t, bitmap_color_t);
+static void spanFill(bitmap_color_t*, uint32_t, bitmap_color_t);
+static inline uint32_t colorWord(bitmap_color_t);
+static void clipSpan(int32_t, int32_t, int32_t, bitmap_color_t);
+static void clipRect(int32_t, int32_t, int32_t, int32_t, bitmap_color_t);
+static uint32_t isqrt(uint32_t);
+static void shapeFill(uint16_t, uint16_t);
+static void shapeRow(uint16_t, uint16_t);
+static void angleVector(uint16_t, int32_t*, int32_t*);
+static void halfPlane(int32_t, int32_t, int32_t*, int32_t*);
+static void arcRow(int32_t, int32_t, int32_t);
+
+//sin(0..90 degree) in Q14
+static const int16_t sinQ14[91] = {
+	0, 286, 572, 857, 1143, 1428, 1713, 1997, 2280, 2563,
+	2845, 3126, 3406, 3686, 3964, 4240, 4516, 4790, 5063, 5334,
+	5604, 5872, 6138, 6402, 6664, 6924, 7182, 7438, 7692, 7943,
+	8192, 8438, 8682, 8923, 9162, 9397, 9630, 9860, 10087, 10311,
+	10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982, 12176, 12365,
+	12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+	14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+	15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+	16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382,
+	16384
+};
+
+//annular sector being filled by bitmap_fillarc (y axis pointing up for the angle tests)
+static struct {
+	int32_t cx;
+	int32_t cy;
+	int32_t ax; //start direction
+	int32_t ay;
+	int32_t bx; //stop direction
+	int32_t by;
+	uint16_t sweep;
+	bitmap_color_t color;
+} arc;
+
+//scanline shape: quarter ellipses around the center rectangle cx0,cy0 - cx1,cy1 (a single point for circles)
+static struct {
+	int32_t cx0;
+	int32_t cy0;
+	int32_t cx1;
+	int32_t cy1;
+	uint16_t orthant; //0: whole shape, 1-4: one quadrant without the center row and column
+	bitmap_color_t color;
+} shape;
 
-void bitmap_setparam(uint16_t _x_max, uint16_t _y_max, uint8_t _color, uint8_t *_bitmap){
+/*
+ * Pixel masks of a font row byte (MSB is the left pixel), one 32bit word per 4 (RGB332) or 2 (RGB565) pixels.
+ * The left pixel is the lowest address (little endian).
+ */
+#if BITMAP_COLOR_FORMAT == BITMAP_RGB565
+#define GLYPH_WORDS 4
+#define GLYPH_WORD(b, n) (((((b) >> (7 - (2 * (n)))) & 1) * 0x0000ffffUL) | ((((b) >> (6 - (2 * (n)))) & 1) * 0xffff0000UL))
+#define GLYPH_MASK(b) {GLYPH_WORD(b, 0), GLYPH_WORD(b, 1), GLYPH_WORD(b, 2), GLYPH_WORD(b, 3)}
+#else
+#define GLYPH_WORDS 2
+#define GLYPH_WORD(b, n) (((((b) >> (7 - (4 * (n)))) & 1) * 0x000000ffUL) | ((((b) >> (6 - (4 * (n)))) & 1) * 0x0000ff00UL) | ((((b) >> (5 - (4 * (n)))) & 1) * 0x00ff0000UL) | ((((b) >> (4 - (4 * (n)))) & 1) * 0xff000000UL))
+#define GLYPH_MASK(b) {GLYPH_WORD(b, 0), GLYPH_WORD(b, 1)}
+#endif
+#define GLYPH_MASK4(b) GLYPH_MASK(b), GLYPH_MASK((b) + 1), GLYPH_MASK((b) + 2), GLYPH_MASK((b) + 3)
+#define GLYPH_MASK16(b) GLYPH_MASK4(b), GLYPH_MASK4((b) + 4), GLYPH_MASK4((b) + 8), GLYPH_MASK4((b) + 12)
+#define GLYPH_MASK64(b) GLYPH_MASK16(b), GLYPH_MASK16((b) + 16), GLYPH_MASK16((b) + 32), GLYPH_MASK16((b) + 48)
+static const uint32_t glyphMask[256][GLYPH_WORDS] = {GLYPH_MASK64(0), GLYPH_MASK64(64), GLYPH_MASK64(128), GLYPH_MASK64(192)};
+
+static void glyphRow(uint16_t, uint16_t, uint8_t, uint8_t, bitmap_color_t);
+static uint8_t recording();
+static void blitRow(bitmap_color_t*, const uint8_t*, uint16_t, uint16_t, const bitmap_image_t*);
+static void blitDirect(int32_t, int32_t, const uint8_t*, uint16_t, uint16_t, const bitmap_image_t*);
+static void rleRow(uint8_t*, uint16_t);
+static uint16_t read16(const uint8_t*);
+static uint32_t read32(const uint8_t*);
+
+//RLE decoder position for bitmap_blit
+static struct {
+	const uint8_t *p;
+	uint8_t count; //bytes left in the current packet
+	uint8_t repeat;
+	uint8_t value;
+	uint8_t row[BITMAP_RLE_ROW_MAX];
+} rle;
+static bitmap_cmd_t *record(uint8_t, int32_t, int32_t, bitmap_color_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t);
+
+void bitmap_setparam(uint16_t _x_max, uint16_t _y_max, bitmap_color_t _color, bitmap_color_t *_bitmap){
 	bitmap_param.width = _x_max;
 	bitmap_param.height = _y_max;
 	bitmap_param.background = _color;
 	bitmap_param.bitmap = _bitmap;
+	stride = _x_max;
+	bitmap_dirty.count = 0;
+	bitmap_dirty.hold = 0;
+	direct = NULL;
+	bitmap_list.cmd = NULL;
+	view_top = 0;
+	view_lines = _y_max;
+	clipReset();
 }
 
-void bitmap_clear(){
-	if(bitmap_param.width == 0){
+/*
+ * Direct rendering without a framebuffer. Every primitive is sent as filled rectangles
+ * (spans, glyph runs, ...) to _direct, e.g. ILI9341_fillRect writing straight into the GRAM.
+ * Nothing can be read back: bitmap_terminal restarts from the top instead of scrolling.
+ */
+void bitmap_setdirect(uint16_t _x_max, uint16_t _y_max, bitmap_color_t _color, bitmap_direct_t _direct){
+	bitmap_setparam(_x_max, _y_max, _color, NULL);
+	direct = _direct;
+}
+
+/*
+ * Display list mode. Primitives are appended to _list (_size commands) instead of drawing,
+ * bitmap_renderBand() replays them into a strip buffer one band at a time (ILI9341_printList).
+ * bitmap_clear() empties the list. Animation frames are kept by reference until the list is rendered.
+ */
+void bitmap_setlist(uint16_t _x_max, uint16_t _y_max, bitmap_color_t _color, bitmap_cmd_t *_list, uint16_t _size){
+	bitmap_setparam(_x_max, _y_max, _color, NULL);
+	bitmap_list.cmd = _list;
+	bitmap_list.size = _size;
+	bitmap_list.count = 0;
+	bitmap_list.overflow = 0;
+	bitmap_list.replay = 0;
+}
+
+/* Replay the display list into _strip (width x _lines) holding rows _y to _y + _lines - 1. Commands outside the band are skipped. */
+void bitmap_renderBand(bitmap_color_t *_strip, uint16_t _y, uint16_t _lines){
+	if((bitmap_list.cmd == NULL) || (_lines == 0)){
+		return;
+	}
+
+	//the recorded clip commands rebuild the stack from the full screen in every band
+	struct clip_t keep = clip;
+	bitmap_param.bitmap = _strip;
+	view_top = _y;
+	view_lines = _lines;
+	bitmap_list.replay = 1;
+	clipReset();
+	fill(0, _y, bitmap_param.width - 1, _y + _lines - 1, bitmap_param.background);
+
+	uint16_t bottom = _y + _lines - 1;
+	for(uint16_t i = 0; i < bitmap_list.count; i++){
+		const bitmap_cmd_t *cmd = &bitmap_list.cmd[i];
+		if((cmd->bottom < _y) || (cmd->top > bottom)){
+			continue;
+		}
+
+		const uint16_t *p = cmd->p;
+		switch(cmd->type){
+		case CMD_PIXEL:
+			bitmap_pixel(p[0], p[1], cmd->color);
+			break;
+		case CMD_LINE:
+			bitmap_line(p[0], p[1], p[2], p[3], cmd->color);
+			break;
+		case CMD_THICKLINE:
+			bitmap_thickline(p[0], p[1], p[2], p[3], p[4], cmd->color);
+			break;
+		case CMD_RECT:
+			bitmap_rect(p[0], p[1], p[2], p[3], p[4], cmd->color);
+			break;
+		case CMD_FILLRECT:
+			bitmap_fillrect(p[0], p[1], p[2], p[3], cmd->color);
+			break;
+		case CMD_CIRCLE:
+			bitmap_circle(p[0], p[1], p[2], p[3], p[4], cmd->color);
+			break;
+		case CMD_FILLCIRCLE:
+			bitmap_fillcircle(p[0], p[1], p[2], p[3], cmd->color);
+			break;
+		case CMD_FILLELLIPSE:
+			bitmap_fillellipse(p[0], p[1], p[2], p[3], cmd->color);
+			break;
+		case CMD_ARC:
+			bitmap_arc(p[0], p[1], p[2], p[3], p[4], p[5], cmd->color);
+			break;
+		case CMD_FILLARC:
+			bitmap_fillarc(p[0], p[1], p[2], p[3], p[4], p[5], cmd->color);
+			break;
+		case CMD_ROUNDRECT:
+			bitmap_roundrect(p[0], p[1], p[2], p[3], p[4], p[5], cmd->color);
+			break;
+		case CMD_FILLROUNDRECT:
+			bitmap_fillroundrect(p[0], p[1], p[2], p[3], p[4], cmd->color);
+			break;
+		case CMD_CHARACTER8:
+			bitmap_characterBitmap8(p[0], p[1], p[2], p[3], p[4], cmd->color);
+			break;
+		case CMD_CHARACTER5:
+			bitmap_characterBitmap5(p[0], p[1], p[2], cmd->color);
+			break;
+		case CMD_ANIMATION4:
+			bitmap_animation_4bit(cmd->src.animation.frame, cmd->src.animation.map, p[0], p[1], p[2], p[3]);
+			break;
+		case CMD_BLIT:
+			bitmap_blit(cmd->src.image, p[0], p[1]);
+			break;
+		case CMD_BLITSURFACE:
+			bitmap_blitSurface(cmd->src.surface, p[0], p[1]);
+			break;
+		case CMD_PUSHCLIP:
+			bitmap_pushClip(p[0], p[1], p[2], p[3]);
+			break;
+		case CMD_POPCLIP:
+			bitmap_popClip();
+			break;
+		}
+	}
+
+	bitmap_list.replay = 0;
+	bitmap_param.bitmap = NULL;
+	view_top = 0;
+	view_lines = bitmap_param.height;
+	clip = keep;
+	clipUpdate();
+}
+
+/*
+ * Restrict drawing to _x0,_y0 - _x1,_y1 (inclusive) intersected with the current clip rectangle,
+ * until the matching bitmap_popClip(). Returns 0 when BITMAP_CLIP_DEPTH rectangles are already pushed (nothing changes).
+ * bitmap_clear() is not clipped.
+ */
+uint8_t bitmap_pushClip(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1){
+	if(clip.depth >= BITMAP_CLIP_DEPTH){
+		return 0;
+	}
+	if(recording()){
+		record(CMD_PUSHCLIP, 0, bitmap_param.height - 1, 0, _x0, _y0, _x1, _y1, 0, 0);
+	}
+
+	clip.stack[clip.depth++] = clip.rect;
+	if(_x0 > clip.rect.x0){
+		clip.rect.x0 = _x0;
+	}
+	if(_y0 > clip.rect.y0){
+		clip.rect.y0 = _y0;
+	}
+	if(_x1 < clip.rect.x1){
+		clip.rect.x1 = _x1;
+	}
+	if(_y1 < clip.rect.y1){
+		clip.rect.y1 = _y1;
+	}
+	clipUpdate();
+	return 1;
+}
+
+void bitmap_popClip(){
+	if(clip.depth == 0){
+		return;
+	}
+	if(recording()){
+		record(CMD_POPCLIP, 0, bitmap_param.height - 1, 0, 0, 0, 0, 0, 0, 0);
+	}
+
+	clip.rect = clip.stack[--clip.depth];
+	clipUpdate();
+}
+
+static void clipReset(){
+	clip.rect.x0 = 0;
+	clip.rect.y0 = 0;
+	clip.rect.x1 = (int32_t)bitmap_param.width - 1;
+	clip.rect.y1 = (int32_t)bitmap_param.height - 1;
+	clip.depth = 0;
+	clipUpdate();
+}
+
+static void clipUpdate(){
+	win = clip.rect;
+	if(win.y0 < view_top){
+		win.y0 = view_top;
+	}
+	if(win.y1 > ((int32_t)view_top + view_lines - 1)){
+		win.y1 = (int32_t)view_top + view_lines - 1;
+	}
+	if((win.x0 > win.x1) || (win.y0 > win.y1)){
+		//empty: a point no coordinate reaches, so every range test rejects
+		win.x0 = win.x1 = win.y0 = win.y1 = 0x40000000;
+	}
+}
+
+//bounding box test: 1 when nothing of it can be drawn
+static uint8_t clipReject(int32_t _x0, int32_t _y0, int32_t _x1, int32_t _y1){
+	return (_x1 < win.x0) || (_x0 > win.x1) || (_y1 < win.y0) || (_y0 > win.y1);
+}
+
+//any rectangle in signed coordinates, filled inside win
+static void clipRect(int32_t _x0, int32_t _y0, int32_t _x1, int32_t _y1, bitmap_color_t _color){
+	if(_x0 > _x1){
+		int32_t tmp = _x0;
+		_x0 = _x1;
+		_x1 = tmp;
+	}
+	if(_y0 > _y1){
+		int32_t tmp = _y0;
+		_y0 = _y1;
+		_y1 = tmp;
+	}
+	if(clipReject(_x0, _y0, _x1, _y1)){
+		return;
+	}
+	fill((_x0 < win.x0) ? win.x0 : _x0, (_y0 < win.y0) ? win.y0 : _y0, (_x1 > win.x1) ? win.x1 : _x1, (_y1 > win.y1) ? win.y1 : _y1, _color);
+}
+
+//integer square root (floor)
+static uint32_t isqrt(uint32_t _n){
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+	while(bit > _n){
+		bit >>= 2;
+	}
+	while(bit != 0){
+		if(_n >= (root + bit)){
+			_n -= root + bit;
+			root = (root >> 1) + bit;
+		}else{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+//Cohen-Sutherland region code against win
+static uint8_t outcode(int32_t _x, int32_t _y){
+	uint8_t code = 0;
+	if(_x < win.x0){
+		code |= 1;
+	}else if(_x > win.x1){
+		code |= 2;
+	}
+	if(_y < win.y0){
+		code |= 4;
+	}else if(_y > win.y1){
+		code |= 8;
+	}
+	return code;
+}
+
+/* Damaged area list. Every primitive marks its bounding box once, overlapping or touching rectangles are merged on insert. */
+void bitmap_markDirty(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1){
+	dirtyAdd(_x0, _y0, _x1, _y1);
+}
+
+void bitmap_clearDirty(){
+	bitmap_dirty.count = 0;
+}
+
+static void dirtyAdd(int32_t _x0, int32_t _y0, int32_t _x1, int32_t _y1){
+	if((bitmap_param.width == 0) || (bitmap_param.bitmap == NULL) || (bitmap_list.cmd != NULL) || (surface != NULL)){
+		return;
+	}
+
+	if(_x0 > _x1){
+		int32_t tmp = _x0;
+		_x0 = _x1;
+		_x1 = tmp;
+	}
+	if(_y0 > _y1){
+		int32_t tmp = _y0;
+		_y0 = _y1;
+		_y1 = tmp;
+	}
+
+	//clamp to framebuffer
+	if((_x1 < 0) || (_y1 < 0) || (_x0 >= bitmap_param.width) || (_y0 >= bitmap_param.height)){
 		return;
 	}
-	term_line = 0;
+	bitmap_rect_t r;
+	r.x0 = (_x0 < 0) ? 0 : _x0;
+	r.y0 = (_y0 < 0) ? 0 : _y0;
+	r.x1 = (_x1 >= bitmap_param.width) ? (bitmap_param.width - 1) : _x1;
+	r.y1 = (_y1 >= bitmap_param.height) ? (bitmap_param.height - 1) : _y1;
+
+	//already covered
+	for(uint8_t i = 0; i < bitmap_dirty.count; i++){
+		bitmap_rect_t *e = &bitmap_dirty.rect[i];
+		if((e->x0 <= r.x0) && (e->y0 <= r.y0) && (e->x1 >= r.x1) && (e->y1 >= r.y1)){
+			return;
+		}
+	}
+
+	while(1){
+		//absorb every rectangle that overlaps or touches the new one
+		uint8_t i = 0;
+		while(i < bitmap_dirty.count){
+			bitmap_rect_t *e = &bitmap_dirty.rect[i];
+			if((e->x0 <= (r.x1 + 1)) && (r.x0 <= (e->x1 + 1)) && (e->y0 <= (r.y1 + 1)) && (r.y0 <= (e->y1 + 1))){
+				if(e->x0 < r.x0) r.x0 = e->x0;
+				if(e->y0 < r.y0) r.y0 = e->y0;
+				if(e->x1 > r.x1) r.x1 = e->x1;
+				if(e->y1 > r.y1) r.y1 = e->y1;
+				bitmap_dirty.rect[i] = bitmap_dirty.rect[--bitmap_dirty.count];
+				i = 0;
+				continue;
+			}
+			i++;
+		}
+
+		if(bitmap_dirty.count < BITMAP_DIRTY_MAX){
+			bitmap_dirty.rect[bitmap_dirty.count++] = r;
+			return;
+		}
+
+		//list is full: merge with the rectangle that grows the least, then re-check overlaps
+		uint8_t best = 0;
+		uint32_t bestGrowth = 0xffffffff;
+		for(i = 0; i < bitmap_dirty.count; i++){
+			bitmap_rect_t *e = &bitmap_dirty.rect[i];
+			uint32_t ux = ((e->x1 > r.x1) ? e->x1 : r.x1) - ((e->x0 < r.x0) ? e->x0 : r.x0) + 1;
+			uint32_t uy = ((e->y1 > r.y1) ? e->y1 : r.y1) - ((e->y0 < r.y0) ? e->y0 : r.y0) + 1;
+			uint32_t growth = ux * uy - (uint32_t)(e->x1 - e->x0 + 1) * (e->y1 - e->y0 + 1);
+			if(growth < bestGrowth){
+				bestGrowth = growth;
+				best = i;
+			}
+		}
+		bitmap_rect_t *e = &bitmap_dirty.rect[best];
+		if(e->x0 < r.x0) r.x0 = e->x0;
+		if(e->y0 < r.y0) r.y0 = e->y0;
+		if(e->x1 > r.x1) r.x1 = e->x1;
+		if(e->y1 > r.y1) r.y1 = e->y1;
+		bitmap_dirty.rect[best] = bitmap_dirty.rect[--bitmap_dirty.count];
+	}
+}
 
-	uint32_t pixels = bitmap_param.width * bitmap_param.height;
-	for(uint32_t i = 0; i < pixels; i++){
-		bitmap_param.bitmap[i] = bitmap_param.background;
+//mark the bounding box of a primitive and stop per-pixel marking until dirtyEnd()
+static void dirtyBegin(int32_t _x0, int32_t _y0, int32_t _x1, int32_t _y1){
+	if(bitmap_dirty.hold == 0){
+		//only the part inside the clip rectangle can change
+		int32_t x0 = (_x0 < _x1) ? _x0 : _x1;
+		int32_t y0 = (_y0 < _y1) ? _y0 : _y1;
+		int32_t x1 = (_x0 < _x1) ? _x1 : _x0;
+		int32_t y1 = (_y0 < _y1) ? _y1 : _y0;
+		if(x0 < clip.rect.x0) x0 = clip.rect.x0;
+		if(y0 < clip.rect.y0) y0 = clip.rect.y0;
+		if(x1 > clip.rect.x1) x1 = clip.rect.x1;
+		if(y1 > clip.rect.y1) y1 = clip.rect.y1;
+		if((x0 <= x1) && (y0 <= y1)){
+			dirtyAdd(x0, y0, x1, y1);
+		}
 	}
+	bitmap_dirty.hold++;
 }
 
-void bitmap_pixel(uint16_t _x, uint16_t _y, uint8_t _color) {
+static void dirtyEnd(){
+	bitmap_dirty.hold--;
+}
+
+void bitmap_clear(){
 	if(bitmap_param.width == 0){
 		return;
 	}
+	if(surface == NULL){
+		term_line = 0;
+		term_top = 0;
+	}
+	if(recording()){
+		//everything before is covered by the background
+		bitmap_list.count = 0;
+		bitmap_list.overflow = 0;
+		return;
+	}
+	dirtyAdd(0, 0, bitmap_param.width - 1, bitmap_param.height - 1);
+	clipRect_t keep = win;
+	win.x0 = 0;
+	win.x1 = (int32_t)bitmap_param.width - 1;
+	win.y0 = view_top;
+	win.y1 = (int32_t)view_top + view_lines - 1;
+	fill(0, 0, bitmap_param.width - 1, bitmap_param.height - 1, bitmap_param.background);
+	win = keep;
+}
+
+void bitmap_pixel(uint16_t _x, uint16_t _y, bitmap_color_t _color) {
+	if((bitmap_param.width == 0) || (_x < win.x0) || (_x > win.x1) || (_y < win.y0) || (_y > win.y1)){
+		return;
+	}
+	if(recording()){
+		record(CMD_PIXEL, _y, _y, _color, _x, _y, 0, 0, 0, 0);
+		return;
+	}
+	if(bitmap_param.bitmap == NULL){
+		directRect(_x, _y, _x, _y, _color);
+		return;
+	}
 
-	bitmap_param.bitmap[(bitmap_param.width * _y) + _x] = _color;
+	if(bitmap_dirty.hold == 0){
+		dirtyAdd(_x, _y, _x, _y);
+	}
+	bitmap_param.bitmap[(stride * (uint32_t)(_y - view_top)) + _x] = _color;
 }
 
 /* Bresenham's line algorithm */
-void bitmap_line(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint8_t _color) {
+void bitmap_line(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, bitmap_color_t _color) {
 	if(bitmap_param.width == 0){
 		return;
 	}
+	uint8_t code0 = outcode(_x0, _y0);
+	uint8_t code1 = outcode(_x1, _y1);
+	if(code0 & code1){
+		//both ends on the same outer side
+		return;
+	}
+	if(recording()){
+		record(CMD_LINE, _y0, _y1, _color, _x0, _y0, _x1, _y1, 0, 0);
+		return;
+	}
+	dirtyBegin(_x0, _y0, _x1, _y1);
 
 	if(_x0 == _x1){
 		uint16_t y_min, y_max;
@@ -52,9 +603,8 @@ void bitmap_line(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint8_t
 			y_min = _y1;
 			y_max = _y0;
 		}
-		for(uint16_t y = y_min; y <= y_max; y++){
-			bitmap_pixel(_x0, y, _color);
-		}
+		vspan(_x0, y_min, y_max, _color);
+		dirtyEnd();
 		return;
 	}
 
@@ -67,15 +617,14 @@ void bitmap_line(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint8_t
 			x_min = _x1;
 			x_max = _x0;
 		}
-		for(uint16_t x = x_min; x <= x_max; x++){
-			bitmap_pixel(x, _y0, _color);
-		}
+		hspan(x_min, x_max, _y0, _color);
+		dirtyEnd();
 		return;
 	}
 
-	int16_t dx = (_x1 > _x0) ? (_x1 - _x0) : (_x0 - _x1);
-	int16_t dy = (_y1 > _y0) ? (_y1 - _y0) : (_y0 - _y1);
-	int16_t sx, sy, err, e2;
+	int32_t dx = (_x1 > _x0) ? (_x1 - _x0) : (_x0 - _x1);
+	int32_t dy = (_y1 > _y0) ? (_y1 - _y0) : (_y0 - _y1);
+	int32_t sx, sy, err, e2;
 
 	if (_x0 < _x1) {
 		sx = 1;
@@ -89,29 +638,240 @@ void bitmap_line(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint8_t
 	}
 	err = dx - dy;
 
-	while (1) {
-		bitmap_pixel(_x0, _y0, _color);
-		if ((_x0 == _x1) && (_y0 == _y1)) {
-			break;
+	//clip once: the steps inside win, from the closed form of the Bresenham walk (same pixels as the unclipped line)
+	int32_t major = (dx > dy) ? dx : dy;
+	int32_t minor = (dx > dy) ? dy : dx;
+	uint32_t first = 0;
+	uint32_t last = major;
+	if((code0 | code1) != 0){
+		int32_t xlo, xhi, ylo, yhi;
+		lineAxis(_x0, sx, win.x0, win.x1, &xlo, &xhi);
+		lineAxis(_y0, sy, win.y0, win.y1, &ylo, &yhi);
+		int32_t klo = (dx > dy) ? xlo : ylo;
+		int32_t khi = (dx > dy) ? xhi : yhi;
+		uint32_t mFirst = lineFirst(major, major, minor, (dx > dy) ? ylo : xlo);
+		uint32_t mEnd = lineFirst(major, major, minor, ((dx > dy) ? yhi : xhi) + 1);
+		if((khi < 0) || (mEnd == 0)){
+			dirtyEnd();
+			return;
+		}
+		first = (klo > (int32_t)mFirst) ? (uint32_t)klo : mFirst;
+		last = ((uint32_t)khi < (mEnd - 1)) ? (uint32_t)khi : (mEnd - 1);
+		if(last > (uint32_t)major){
+			last = major;
+		}
+		if(first > last){
+			dirtyEnd();
+			return;
+		}
+
+		int32_t g;
+		uint32_t m = lineSteps(first, major, minor, &g);
+		if(dx > dy){
+			_x0 += sx * (int32_t)first;
+			_y0 += sy * (int32_t)m;
+			err = g;
+		}else{
+			_y0 += sy * (int32_t)first;
+			_x0 += sx * (int32_t)m;
+			err = -g;
+		}
+	}
+	uint32_t n = last - first;
+
+	if(bitmap_param.bitmap == NULL){
+		//merge the steps along the major axis so each run is one window
+		uint16_t run_x = _x0;
+		uint16_t run_y = _y0;
+		while (1) {
+			uint16_t x = _x0;
+			uint16_t y = _y0;
+			if (n == 0) {
+				directRect(run_x, run_y, x, y, _color);
+				break;
+			}
+			n--;
+			e2 = 2 * err;
+			if (e2 > -dy) {
+				err -= dy;
+				_x0 += sx;
+			}
+			if (e2 < dx) {
+				err += dx;
+				_y0 += sy;
+			}
+			if (((dx >= dy) && (_y0 != y)) || ((dx < dy) && (_x0 != x))) {
+				directRect(run_x, run_y, x, y, _color);
+				run_x = _x0;
+				run_y = _y0;
+			}
+		}
+		dirtyEnd();
+		return;
+	}
+
+	//no checks per pixel, step a framebuffer pointer. One step along the major axis per pixel
+	bitmap_color_t *p = &bitmap_param.bitmap[(stride * (uint32_t)(_y0 - view_top)) + _x0];
+	int32_t stepY = sy * (int32_t)stride;
+	if(dx == dy){
+		//45 degree: both axes every step
+		int32_t step = sx + stepY;
+		*p = _color;
+		for(; n > 0; n--){
+			p += step;
+			*p = _color;
+		}
+	}else{
+		*p = _color;
+		for(; n > 0; n--){
+			e2 = 2 * err;
+			if (e2 > -dy) {
+				err -= dy;
+				p += sx;
+			}
+			if (e2 < dx) {
+				err += dx;
+				p += stepY;
+			}
+			*p = _color;
 		}
-		e2 = 2 * err;
-		if (e2 > -dy) {
-			err -= dy;
-			_x0 += sx;
+	}
+	dirtyEnd();
+}
+
+/*
+ * Bresenham walk of bitmap_line in closed form. Every step moves along the major axis; the error term
+ * (err of the major axis, -err when y is major) stays in [(_major + 1) / 2 - _minor, that + _major).
+ * Returns the minor axis steps after _k steps and the error term in *_err.
+ */
+static uint32_t lineSteps(uint32_t _k, int32_t _major, int32_t _minor, int32_t *_err){
+	int64_t low = ((_major + 1) / 2) - _minor;
+	int64_t start = _major - _minor;
+	int64_t e = (start - ((int64_t)_k * _minor) - low) % _major;
+	if(e < 0){
+		e += _major;
+	}
+	e += low;
+	*_err = (int32_t)e;
+	return (uint32_t)((e - start + ((int64_t)_k * _minor)) / _major);
+}
+
+//first step of a _n step line whose minor axis has moved _m times, _n + 1: none (binary search, minor steps never decrease)
+static uint32_t lineFirst(uint32_t _n, int32_t _major, int32_t _minor, int32_t _m){
+	if(_m <= 0){
+		return 0;
+	}
+	uint32_t low = 0;
+	uint32_t high = _n + 1;
+	while(low < high){
+		uint32_t middle = (low + high) / 2;
+		int32_t err;
+		if(lineSteps(middle, _major, _minor, &err) >= (uint32_t)_m){
+			high = middle;
+		}else{
+			low = middle + 1;
 		}
-		if (e2 < dx) {
-			err += dx;
-			_y0 += sy;
+	}
+	return low;
+}
+
+//steps along one axis (from _a in direction _s) that keep it inside _w0.._w1
+static void lineAxis(int32_t _a, int32_t _s, int32_t _w0, int32_t _w1, int32_t *_lo, int32_t *_hi){
+	if(_s > 0){
+		*_lo = _w0 - _a;
+		*_hi = _w1 - _a;
+	}else{
+		*_lo = _a - _w1;
+		*_hi = _a - _w0;
+	}
+}
+
+/*
+ * Line _width pixels wide (measured across the line). Every Bresenham run along the major axis becomes one
+ * rectangle (mostly horizontal lines) or one span per row (mostly vertical lines), so nothing is drawn twice.
+ */
+void bitmap_thickline(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint16_t _width, bitmap_color_t _color){
+	if(_width <= 1){
+		bitmap_line(_x0, _y0, _x1, _y1, _color);
+		return;
+	}
+	if(bitmap_param.width == 0){
+		return;
+	}
+	int32_t x_min = (_x0 < _x1) ? _x0 : _x1;
+	int32_t x_max = (_x0 < _x1) ? _x1 : _x0;
+	int32_t y_min = (_y0 < _y1) ? _y0 : _y1;
+	int32_t y_max = (_y0 < _y1) ? _y1 : _y0;
+	if(clipReject(x_min - _width, y_min - _width, x_max + _width, y_max + _width)){
+		return;
+	}
+	if(recording()){
+		record(CMD_THICKLINE, y_min - _width, y_max + _width, _color, _x0, _y0, _x1, _y1, _width, 0);
+		return;
+	}
+
+	int32_t dx = x_max - x_min;
+	int32_t dy = y_max - y_min;
+	int32_t major = (dx > dy) ? dx : dy;
+	//thickness along the minor axis that gives _width across the line
+	uint32_t across = _width;
+	if((dx != 0) && (dy != 0)){
+		across = ((uint32_t)_width * isqrt((uint32_t)dx * dx + (uint32_t)dy * dy) + (major / 2)) / major;
+	}
+	int32_t lo = (across - 1) / 2;
+	int32_t hi = across - 1 - lo;
+
+	dirtyBegin(x_min - across, y_min - across, x_max + across, y_max + across);
+	if(dy == 0){
+		clipRect(x_min, (int32_t)_y0 - lo, x_max, (int32_t)_y0 + hi, _color);
+	}else if(dx == 0){
+		clipRect((int32_t)_x0 - lo, y_min, (int32_t)_x0 + hi, y_max, _color);
+	}else{
+		int32_t x = _x0;
+		int32_t y = _y0;
+		int32_t sx = (_x0 < _x1) ? 1 : -1;
+		int32_t sy = (_y0 < _y1) ? 1 : -1;
+		int32_t err = dx - dy;
+		int32_t run = x; //first x of the current row
+		for(int32_t n = major; ; n--){
+			int32_t e2 = 2 * err;
+			uint8_t last = (n == 0);
+			if(dx > dy){
+				//row complete at the end or before y steps
+				if(last || (e2 < dx)){
+					clipRect(run, y - lo, x, y + hi, _color);
+				}
+			}else{
+				clipRect(x - lo, y, x + hi, y, _color);
+			}
+			if(last){
+				break;
+			}
+			if (e2 > -dy) {
+				err -= dy;
+				x += sx;
+			}
+			if (e2 < dx) {
+				err += dx;
+				y += sy;
+				run = x;
+			}
 		}
 	}
-	return;
+	dirtyEnd();
 }
 
-void bitmap_bezier(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint16_t _x2, uint16_t _y2, uint8_t _color){
+void bitmap_bezier(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint16_t _x2, uint16_t _y2, bitmap_color_t _color){
 	int16_t diff_x0, diff_y0, diff_x1, diff_y1;
 	diff_x0 = _x0;
 	diff_y0 = _y0;
 
+	int32_t min_x = (_x0 < _x1) ? _x0 : _x1;
+	int32_t max_x = (_x0 > _x1) ? _x0 : _x1;
+	int32_t min_y = (_y0 < _y1) ? _y0 : _y1;
+	int32_t max_y = (_y0 > _y1) ? _y0 : _y1;
+	dirtyBegin((min_x < _x2) ? min_x : _x2, (min_y < _y2) ? min_y : _y2, (max_x > _x2) ? max_x : _x2, (max_y > _y2) ? max_y : _y2);
+
     for (double t = 0; t <= 1; t += 0.2) {
     	diff_x1 = (int16_t)((1 - t) * (1 - t) * _x0 + 2 * t * (1 - t) * _x1 + t * t * _x2);
     	diff_y1 = (int16_t)((1 - t) * (1 - t) * _y0 + 2 * t * (1 - t) * _y1 + t * t * _y2);
@@ -120,26 +880,49 @@ void bitmap_bezier(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint1
 		diff_x0 = diff_x1;
 		diff_y0 = diff_y1;
     }
+	dirtyEnd();
+}
+
+//horizontal line _x0 to _x1 at _y, written as one span
+void bitmap_hspan(uint16_t _x0, uint16_t _x1, uint16_t _y, bitmap_color_t _color){
+	if(bitmap_param.width == 0){
+		return;
+	}
+	if(_x0 > _x1){
+		uint16_t tmp = _x0;
+		_x0 = _x1;
+		_x1 = tmp;
+	}
+	if(recording()){
+		record(CMD_FILLRECT, _y, _y, _color, _x0, _y, _x1, _y, 0, 0);
+		return;
+	}
+
+	dirtyBegin(_x0, _y, _x1, _y);
+	hspan(_x0, _x1, _y, _color);
+	dirtyEnd();
 }
 
-void bitmap_rect(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint16_t _width, uint8_t _color) {
+void bitmap_rect(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint16_t _width, bitmap_color_t _color) {
 	if(bitmap_param.width == 0){
 		return;
 	}
+	if(recording()){
+		record(CMD_RECT, _y0, _y1, _color, _x0, _y0, _x1, _y1, _width, 0);
+		return;
+	}
+	dirtyBegin(_x0, _y0, _x1, _y1);
 
 	for(uint16_t i = 0; i < _width; i++){
-		for(uint16_t y = _y0; y <= _y1; y++){
-			bitmap_pixel(_x0 + i, y, _color);
-			bitmap_pixel(_x1 - i, y, _color);
-		}
-		for(uint16_t x = _x0; x <= _x1; x++){
-			bitmap_pixel(x, _y0 + i, _color);
-			bitmap_pixel(x, _y1 - i, _color);
-		}
+		vspan(_x0 + i, _y0, _y1, _color);
+		vspan(_x1 - i, _y0, _y1, _color);
+		hspan(_x0, _x1, _y0 + i, _color);
+		hspan(_x0, _x1, _y1 - i, _color);
 	}
+	dirtyEnd();
 }
 
-void bitmap_fillrect(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint8_t _color) {
+void bitmap_fillrect(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, bitmap_color_t _color) {
 	if(bitmap_param.width == 0){
 		return;
 	}
@@ -155,15 +938,25 @@ void bitmap_fillrect(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uin
 		_y0 = _y1;
 		_y1 = tmp;
 	}
-
-	for(uint16_t x = _x0; x <= _x1; x++){
-		for(uint16_t y = _y0; y <= _y1; y++){
-			bitmap_pixel(x, y, _color);
-		}
+	if(recording()){
+		record(CMD_FILLRECT, _y0, _y1, _color, _x0, _y0, _x1, _y1, 0, 0);
+		return;
 	}
+
+	dirtyBegin(_x0, _y0, _x1, _y1);
+	fill(_x0, _y0, _x1, _y1, _color);
+	dirtyEnd();
 }
 
-void bitmap_circle(uint16_t _x, uint16_t _y, uint16_t _round, uint16_t _orthant, uint16_t _width, uint8_t _color){
+void bitmap_circle(uint16_t _x, uint16_t _y, uint16_t _round, uint16_t _orthant, uint16_t _width, bitmap_color_t _color){
+	if(clipReject((int32_t)_x - _round, (int32_t)_y - _round, (int32_t)_x + _round, (int32_t)_y + _round)){
+		return;
+	}
+	if(recording()){
+		record(CMD_CIRCLE, (int32_t)_y - _round, (int32_t)_y + _round, _color, _x, _y, _round, _orthant, _width, 0);
+		return;
+	}
+	dirtyBegin((int32_t)_x - _round, (int32_t)_y - _round, (int32_t)_x + _round, (int32_t)_y + _round);
 	for(uint16_t i = 0; i < _width; i++){
 		int32_t f = 1 - _round;
 		uint16_t ddF_x = 1;
@@ -207,64 +1000,72 @@ void bitmap_circle(uint16_t _x, uint16_t _y, uint16_t _round, uint16_t _orthant,
 		}
 		_round--;
 	}
+	dirtyEnd();
 }
 
-void bitmap_fillcircle(uint16_t _x, uint16_t _y, uint16_t _round, uint16_t _orthant, uint8_t _color){
-	int32_t f = 1 - _round;
-	uint16_t ddF_x = 1;
-	int32_t ddF_y = -2 * _round;
-	uint16_t x = 0;
-	uint16_t y = _round;
-
-	if(_orthant == 0){
-		for(uint16_t i = 0; i < _round; i++){
-			bitmap_pixel(_x, _y + i, _color);
-			bitmap_pixel(_x, _y - i, _color);
-			bitmap_pixel(_x + i, _y, _color);
-			bitmap_pixel(_x - i, _y, _color);
-		}
+void bitmap_fillcircle(uint16_t _x, uint16_t _y, uint16_t _round, uint16_t _orthant, bitmap_color_t _color){
+	if((bitmap_param.width == 0) || clipReject((int32_t)_x - _round, (int32_t)_y - _round, (int32_t)_x + _round, (int32_t)_y + _round)){
+		return;
+	}
+	if(recording()){
+		record(CMD_FILLCIRCLE, (int32_t)_y - _round, (int32_t)_y + _round, _color, _x, _y, _round, _orthant, 0, 0);
+		return;
 	}
 
-	while (x < y) {
-		if (f >= 0) {
-			y--;
-			ddF_y += 2;
-			f += ddF_y;
-		}
-		x++;
-		ddF_x += 2;
-		f += ddF_x;
+	dirtyBegin((int32_t)_x - _round, (int32_t)_y - _round, (int32_t)_x + _round, (int32_t)_y + _round);
+	shape.cx0 = _x;
+	shape.cy0 = _y;
+	shape.cx1 = _x;
+	shape.cy1 = _y;
+	shape.orthant = _orthant;
+	shape.color = _color;
+	shapeFill(_round, _round);
+	dirtyEnd();
+}
 
-		if((_orthant == 0) || (_orthant == 1)){
-			bitmap_line(_x + x, _y - y, _x + x, _y - 1, _color);
-			bitmap_line(_x + y, _y - x, _x + y, _y - 1, _color);
-		}
-		if((_orthant == 0) || (_orthant == 2)){
-			bitmap_line(_x - x, _y - y, _x - x, _y - 1, _color);
-			bitmap_line(_x - y, _y - x, _x - y, _y - 1, _color);
-		}
-		if((_orthant == 0) || (_orthant == 3)){
-			bitmap_line(_x - x, _y + y, _x - x, _y + 1, _color);
-			bitmap_line(_x - y, _y + x, _x - y, _y + 1, _color);
-		}
-		if((_orthant == 0) || (_orthant == 4)){
-			bitmap_line(_x + x, _y + y, _x + x, _y + 1, _color);
-			bitmap_line(_x + y, _y + x, _x + y, _y + 1, _color);
-		}
+void bitmap_fillellipse(uint16_t _x, uint16_t _y, uint16_t _rx, uint16_t _ry, bitmap_color_t _color){
+	if((bitmap_param.width == 0) || clipReject((int32_t)_x - _rx, (int32_t)_y - _ry, (int32_t)_x + _rx, (int32_t)_y + _ry)){
+		return;
+	}
+	if(recording()){
+		record(CMD_FILLELLIPSE, (int32_t)_y - _ry, (int32_t)_y + _ry, _color, _x, _y, _rx, _ry, 0, 0);
+		return;
 	}
+
+	dirtyBegin((int32_t)_x - _rx, (int32_t)_y - _ry, (int32_t)_x + _rx, (int32_t)_y + _ry);
+	shape.cx0 = _x;
+	shape.cy0 = _y;
+	shape.cx1 = _x;
+	shape.cy1 = _y;
+	shape.orthant = 0;
+	shape.color = _color;
+	shapeFill(_rx, _ry);
+	dirtyEnd();
 }
 
-void bitmap_arc(uint16_t _x, uint16_t _y, uint16_t _round, uint16_t _startAngle, uint16_t _stopAngle, uint16_t _width, uint8_t _color){
+void bitmap_arc(uint16_t _x, uint16_t _y, uint16_t _round, uint16_t _startAngle, uint16_t _stopAngle, uint16_t _width, bitmap_color_t _color){
 	if((_startAngle > _stopAngle) || (_startAngle > 720) || (_stopAngle > 720)){
 		return;
 	}
+	if(clipReject((int32_t)_x - _round, (int32_t)_y - _round, (int32_t)_x + _round, (int32_t)_y + _round)){
+		return;
+	}
+	if(recording()){
+		record(CMD_ARC, (int32_t)_y - _round, (int32_t)_y + _round, _color, _x, _y, _round, _startAngle, _stopAngle, _width);
+		return;
+	}
 	if((_startAngle >= 360) && (_stopAngle > 360)){
 		_startAngle -= 360;
 		_stopAngle -= 360;
 	}
+	if(_width > 1){
+		bitmap_fillarc(_x, _y, (_width > _round) ? 0 : (_round - _width + 1), _round, _startAngle, _stopAngle, _color);
+		return;
+	}
 	uint16_t start360 = _startAngle % 360;
 	uint16_t stop360 = _stopAngle % 360;
 
+	dirtyBegin((int32_t)_x - _round, (int32_t)_y - _round, (int32_t)_x + _round, (int32_t)_y + _round);
 	for(uint16_t i = 0; i < _width; i++){
 		int32_t f = 1 - _round;
 		uint16_t ddF_x = 1;
@@ -372,63 +1173,133 @@ void bitmap_arc(uint16_t _x, uint16_t _y, uint16_t _round, uint16_t _startAngle,
 		}
 		_round--;
 	}
+	dirtyEnd();
 }
 
-void bitmap_roundrect(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint16_t _round, uint16_t _width, uint8_t _color) {
+/*
+ * Filled annular sector: _inner <= distance <= _outer, from _startAngle to _stopAngle (counterclockwise, 0: right, 90: up).
+ * Each row is cut into at most four spans: angle tests are cross products with Q14 direction vectors,
+ * solved for x once per row instead of per pixel.
+ */
+void bitmap_fillarc(uint16_t _x, uint16_t _y, uint16_t _inner, uint16_t _outer, uint16_t _startAngle, uint16_t _stopAngle, bitmap_color_t _color){
 	if(bitmap_param.width == 0){
 		return;
 	}
-
-	if(((_x1 - _x0) < (2 * _round)) || ((_y1 - _y0) < (2 * _round))){
+	if((_startAngle > _stopAngle) || (_startAngle > 720) || (_stopAngle > 720) || (_inner > _outer)){
+		return;
+	}
+	if(clipReject((int32_t)_x - _outer, (int32_t)_y - _outer, (int32_t)_x + _outer, (int32_t)_y + _outer)){
+		return;
+	}
+	if(recording()){
+		record(CMD_FILLARC, (int32_t)_y - _outer, (int32_t)_y + _outer, _color, _x, _y, _inner, _outer, _startAngle, _stopAngle);
 		return;
 	}
 
-	for(uint16_t i = 0; i < _width; i++){
-		for(uint16_t y = (_y0 + _round); y <= (_y1 - _round); y++){
-			bitmap_pixel(_x0 + i, y, _color);
-			bitmap_pixel(_x1 - i, y, _color);
+	arc.cx = _x;
+	arc.cy = _y;
+	arc.sweep = _stopAngle - _startAngle;
+	arc.color = _color;
+	angleVector(_startAngle, &arc.ax, &arc.ay);
+	angleVector(_stopAngle, &arc.bx, &arc.by);
+
+	dirtyBegin((int32_t)_x - _outer, (int32_t)_y - _outer, (int32_t)_x + _outer, (int32_t)_y + _outer);
+	int32_t outer2 = (int32_t)_outer * _outer + _outer;
+	int32_t inner2 = (int32_t)_inner * _inner - _inner;
+	int32_t xo = _outer;
+	int32_t xi = _inner;
+	for(int32_t dy = 0; dy <= _outer; dy++){
+		//outer: last x inside, inner: first x outside the hole (0: no hole)
+		while((xo * xo + dy * dy) > outer2){
+			xo--;
 		}
-		for(uint16_t x = (_x0 + _round); x <= (_x1 - _round); x++){
-			bitmap_pixel(x, _y0 + i, _color);
-			bitmap_pixel(x, _y1 - i, _color);
+		while((xi > 0) && (((xi - 1) * (xi - 1) + dy * dy) > inner2)){
+			xi--;
 		}
-	}
+		if(_inner == 0){
+			xi = 0;
+		}
+
+		if(xi == 0){
+			arcRow(-xo, xo, dy);
+			if(dy != 0){
+				arcRow(-xo, xo, -dy);
+			}
+		}else{
+			arcRow(-xo, -xi, dy);
+			arcRow(xi, xo, dy);
+			if(dy != 0){
+				arcRow(-xo, -xi, -dy);
+				arcRow(xi, xo, -dy);
+			}
+		}
+	}
+	dirtyEnd();
+}
+
+void bitmap_roundrect(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint16_t _round, uint16_t _width, bitmap_color_t _color) {
+	if(bitmap_param.width == 0){
+		return;
+	}
+
+	if(((_x1 - _x0) < (2 * _round)) || ((_y1 - _y0) < (2 * _round)) || clipReject(_x0, _y0, _x1, _y1)){
+		return;
+	}
+	if(recording()){
+		record(CMD_ROUNDRECT, _y0, _y1, _color, _x0, _y0, _x1, _y1, _round, _width);
+		return;
+	}
+
+	dirtyBegin(_x0, _y0, _x1, _y1);
+	for(uint16_t i = 0; i < _width; i++){
+		vspan(_x0 + i, _y0 + _round, _y1 - _round, _color);
+		vspan(_x1 - i, _y0 + _round, _y1 - _round, _color);
+		hspan(_x0 + _round, _x1 - _round, _y0 + i, _color);
+		hspan(_x0 + _round, _x1 - _round, _y1 - i, _color);
+	}
 
 	bitmap_circle(_x1 - _round, _y0 + _round, _round, 1, _width, _color);
 	bitmap_circle(_x0 + _round, _y0 + _round, _round, 2, _width, _color);
 	bitmap_circle(_x0 + _round, _y1 - _round, _round, 3, _width, _color);
 	bitmap_circle(_x1 - _round, _y1 - _round, _round, 4, _width, _color);
+	dirtyEnd();
 }
 
-void bitmap_fillroundrect(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint16_t _round, uint8_t _color) {
+void bitmap_fillroundrect(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint16_t _round, bitmap_color_t _color) {
 	if(bitmap_param.width == 0){
 		return;
 	}
 
-	if(((_x1 - _x0) < (2 * _round)) || ((_y1 - _y0) < (2 * _round))){
+	if(((_x1 - _x0) < (2 * _round)) || ((_y1 - _y0) < (2 * _round)) || clipReject(_x0, _y0, _x1, _y1)){
+		return;
+	}
+	if(recording()){
+		record(CMD_FILLROUNDRECT, _y0, _y1, _color, _x0, _y0, _x1, _y1, _round, 0);
 		return;
 	}
 
-	bitmap_fillrect(_x0 + _round, _y0 + _round, _x1 - _round, _y1 - _round, _color);
-
-	bitmap_fillrect(_x0, _y0 + _round, _x0 + _round, _y1 - _round, _color);
-	bitmap_fillrect(_x1 - _round, _y0 + _round, _x1, _y1 - _round, _color);
-	bitmap_fillrect(_x0 + _round, _y0, _x1 - _round, _y0 + _round, _color);
-	bitmap_fillrect(_x0 + _round, _y1 - _round, _x1 - _round, _y1, _color);
-
-	bitmap_fillcircle(_x1 - _round, _y0 + _round, _round, 1, _color);
-	bitmap_fillcircle(_x0 + _round, _y0 + _round, _round, 2, _color);
-	bitmap_fillcircle(_x0 + _round, _y1 - _round, _round, 3, _color);
-	bitmap_fillcircle(_x1 - _round, _y1 - _round, _round, 4, _color);
+	dirtyBegin(_x0, _y0, _x1, _y1);
+	shape.cx0 = _x0 + _round;
+	shape.cy0 = _y0 + _round;
+	shape.cx1 = _x1 - _round;
+	shape.cy1 = _y1 - _round;
+	shape.orthant = 0;
+	shape.color = _color;
+	shapeFill(_round, _round);
+	dirtyEnd();
 }
 
-void bitmap_stringBitmap(uint16_t _x, uint16_t _y, const char _character[], uint8_t _size, uint8_t _font, uint8_t _color) {
+void bitmap_stringBitmap(uint16_t _x, uint16_t _y, const char _character[], uint8_t _size, uint8_t _font, bitmap_color_t _color) {
 	if(bitmap_param.width == 0){
 		return;
 	}
 
 	uint8_t c = 0;
 	while (_character[c]) {
+		if(((int32_t)_x + (c * ((_size == 0) ? 4 : (8 * _size)))) > win.x1){
+			//the rest is right of the clip rectangle
+			break;
+		}
 		if (_size == 0) {
 			bitmap_characterBitmap5(_x + (c * 4), _y, _character[c], _color);
 		} else {
@@ -438,97 +1309,1167 @@ void bitmap_stringBitmap(uint16_t _x, uint16_t _y, const char _character[], uint
 	}
 }
 
-void bitmap_characterBitmap8(uint16_t _x, uint16_t _y, char _character, uint8_t _size, uint8_t _font, uint8_t _color) {
-	uint8_t index = 0;
+void bitmap_characterBitmap8(uint16_t _x, uint16_t _y, char _character, uint8_t _size, uint8_t _font, bitmap_color_t _color) {
+	if(bitmap_param.width == 0){
+		return;
+	}
 	if(_size < 1){
 		_size = 1;
 	}
+	if(clipReject(_x, _y, (int32_t)_x + (8 * _size) - 1, (int32_t)_y + (8 * _size) - 1)){
+		return;
+	}
+	if(recording()){
+		record(CMD_CHARACTER8, _y, (int32_t)_y + (8 * _size) - 1, _color, _x, _y, (uint8_t)_character, _size, _font, 0);
+		return;
+	}
 
+	dirtyBegin(_x, _y, _x + (8 * _size) - 1, _y + (8 * _size) - 1);
 	for (uint8_t y = 0; y < 8; y++) {
-		uint16_t fontByte;
-		fontByte = FONT8x8[_font][_character - 0x1F][y];
-
-		for (uint8_t x = 0; x < 8; x++) {
-			if (fontByte & 0x80) {
-				if(_size == 1){
-					bitmap_pixel(_x + (index % 8), _y + (index / 8), _color);
-				}else{
-					uint16_t _x_exp = _x + (index % 8) * _size;
-					uint16_t _y_exp = _y + (index / 8) * _size;
-					bitmap_fillrect(_x_exp, _y_exp, _x_exp + _size - 1, _y_exp + _size - 1, _color);
-				}
+		glyphRow(_x, _y + (y * _size), FONT8x8[_font][_character - 0x1F][y], _size, _color);
+	}
+	dirtyEnd();
+}
+
+void bitmap_characterBitmap5(uint16_t _x, uint16_t _y, char _character, bitmap_color_t _color) {
+	if((bitmap_param.width == 0) || clipReject(_x, _y, (int32_t)_x + 2, (int32_t)_y + 4)){
+		return;
+	}
+	if(recording()){
+		record(CMD_CHARACTER5, _y, (int32_t)_y + 4, _color, _x, _y, (uint8_t)_character, 0, 0, 0);
+		return;
+	}
+	//15 bits, 3 per row from the MSB
+	uint16_t glyph = (FONT5x3[_character - 0x1F][0] << 8) | FONT5x3[_character - 0x1F][1];
+
+	dirtyBegin(_x, _y, _x + 2, _y + 4);
+	for (uint8_t y = 0; y < 5; y++) {
+		glyphRow(_x, _y + y, ((glyph >> (13 - (3 * y))) & 0x07) << 5, 1, _color);
+	}
+	dirtyEnd();
+}
+
+void bitmap_terminal(const char _character[], uint8_t _font, bitmap_color_t _color, uint8_t _max_line){
+	if(bitmap_param.width == 0){
+		return;
+	}
+
+	if((term_line >= _max_line) && (bitmap_param.bitmap == NULL)){
+		//nothing to move without a framebuffer: clear and start again from the top
+		bitmap_fillrect(0, 0, bitmap_param.width - 1, (8 * _max_line) - 1, bitmap_param.background);
+		term_line = 0;
+	}else if(term_line >= _max_line){
+		uint16_t max_y = 8 * _max_line;
+		dirtyAdd(0, 0, bitmap_param.width - 1, max_y - 1);
+		//the terminal rows are contiguous: one block move and one span for the new line
+		uint32_t line = 8 * (uint32_t)bitmap_param.width;
+		memmove(bitmap_param.bitmap, &bitmap_param.bitmap[line], (max_y - 8) * (uint32_t)bitmap_param.width * sizeof(bitmap_color_t));
+		spanFill(&bitmap_param.bitmap[(max_y - 8) * (uint32_t)bitmap_param.width], line, bitmap_param.background);
+		term_line = _max_line - 1;
+	}
+
+	terminalLine(_character, _font, _color, term_line);
+	term_line++;
+}
+
+/*
+ * Terminal for hardware vertical scrolling. The terminal lines are used as a ring:
+ * when full, the oldest line is cleared and rewritten instead of moving the whole region up.
+ * Returns the framebuffer line (0 to _max_line - 1) that was written.
+ * bitmap_terminalOffset() gives the scroll offset that shows the ring in order.
+ */
+uint8_t bitmap_terminalRing(const char _character[], uint8_t _font, bitmap_color_t _color, uint8_t _max_line){
+	if((bitmap_param.width == 0) || (_max_line == 0)){
+		return 0;
+	}
+
+	uint16_t line;
+	if(term_line < _max_line){
+		line = (term_top + term_line) % _max_line;
+		term_line++;
+	}else{
+		line = term_top;
+		term_top = (term_top + 1) % _max_line;
+
+		bitmap_fillrect(0, line * 8, bitmap_param.width - 1, line * 8 + 7, bitmap_param.background);
+	}
+
+	terminalLine(_character, _font, _color, line);
+	return line;
+}
+
+//rows to scroll so that the oldest ring line is at the top of the terminal
+uint16_t bitmap_terminalOffset(){
+	return term_top * 8;
+}
+
+//send a rectangle to the direct target, clipped
+static void directRect(int32_t _x0, int32_t _y0, int32_t _x1, int32_t _y1, bitmap_color_t _color){
+	if(direct == NULL){
+		return;
+	}
+	if(_x0 > _x1){
+		int32_t tmp = _x0;
+		_x0 = _x1;
+		_x1 = tmp;
+	}
+	if(_y0 > _y1){
+		int32_t tmp = _y0;
+		_y0 = _y1;
+		_y1 = tmp;
+	}
+	if(clipReject(_x0, _y0, _x1, _y1)){
+		return;
+	}
+	direct((_x0 < win.x0) ? win.x0 : _x0, (_y0 < win.y0) ? win.y0 : _y0,
+			(_x1 > win.x1) ? win.x1 : _x1, (_y1 > win.y1) ? win.y1 : _y1, _color);
+}
+
+//horizontal span _x0 to _x1 (_x0 <= _x1)
+static void hspan(uint16_t _x0, uint16_t _x1, uint16_t _y, bitmap_color_t _color){
+	if(bitmap_param.bitmap == NULL){
+		directRect(_x0, _y, _x1, _y, _color);
+		return;
+	}
+	if((_y < win.y0) || (_y > win.y1) || (_x1 < win.x0) || (_x0 > win.x1)){
+		return;
+	}
+	if(_x0 < win.x0){
+		_x0 = win.x0;
+	}
+	if(_x1 > win.x1){
+		_x1 = win.x1;
+	}
+	spanFill(&bitmap_param.bitmap[((uint32_t)stride * (_y - view_top)) + _x0], (uint32_t)_x1 - _x0 + 1, _color);
+}
+
+//vertical span _y0 to _y1 (_y0 <= _y1)
+static void vspan(uint16_t _x, uint16_t _y0, uint16_t _y1, bitmap_color_t _color){
+	if(bitmap_param.bitmap == NULL){
+		directRect(_x, _y0, _x, _y1, _color);
+		return;
+	}
+	if(_y0 < win.y0){
+		_y0 = win.y0;
+	}
+	if(_y1 > win.y1){
+		_y1 = win.y1;
+	}
+	if((_x < win.x0) || (_x > win.x1) || (_y0 > _y1)){
+		return;
+	}
+	bitmap_color_t *p = &bitmap_param.bitmap[((uint32_t)stride * (_y0 - view_top)) + _x];
+	for(uint32_t n = (uint32_t)_y1 - _y0 + 1; n > 0; n--){
+		*p = _color;
+		p += stride;
+	}
+}
+
+//filled rectangle, row by row (_x0 <= _x1, _y0 <= _y1)
+static void fill(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, bitmap_color_t _color){
+	if(bitmap_param.bitmap == NULL){
+		directRect(_x0, _y0, _x1, _y1, _color);
+		return;
+	}
+	if(_y0 < win.y0){
+		_y0 = win.y0;
+	}
+	if(_y1 > win.y1){
+		_y1 = win.y1;
+	}
+	if(_y0 > _y1){
+		return;
+	}
+	if((win.x0 == 0) && (_x0 == 0) && (win.x1 == (bitmap_param.width - 1)) && (_x1 >= win.x1) && (stride == bitmap_param.width)){
+		//full rows are contiguous
+		spanFill(&bitmap_param.bitmap[(uint32_t)bitmap_param.width * (_y0 - view_top)], (uint32_t)bitmap_param.width * (_y1 - _y0 + 1), _color);
+		return;
+	}
+	for(uint32_t y = _y0; y <= _y1; y++){
+		hspan(_x0, _x1, y, _color);
+	}
+}
+
+//horizontal span in signed coordinates
+static void clipSpan(int32_t _x0, int32_t _x1, int32_t _y, bitmap_color_t _color){
+	if((_y < win.y0) || (_y > win.y1) || (_x1 < win.x0) || (_x0 > win.x1) || (_x0 > _x1)){
+		return;
+	}
+	hspan((_x0 < win.x0) ? win.x0 : _x0, (_x1 > win.x1) ? win.x1 : _x1, _y, _color);
+}
+
+/*
+ * Midpoint ellipse (Kennedy) emitting every row of the shape once as a span: no overdraw.
+ * Part 1 walks from (_rx, 0) and steps y every time, part 2 walks from (0, _ry) and steps x,
+ * so part 2 only has to finish the rows above the last row of part 1.
+ */
+static void shapeFill(uint16_t _rx, uint16_t _ry){
+	//rows between the two halves of a rounded rectangle
+	if(shape.orthant == 0){
+		for(int32_t y = shape.cy0 + 1; y < shape.cy1; y++){
+			clipSpan(shape.cx0 - _rx, shape.cx1 + _rx, y, shape.color);
+		}
+	}
+
+	if((_rx == 0) || (_ry == 0)){
+		for(uint16_t dy = 0; dy <= _ry; dy++){
+			shapeRow(dy, _rx);
+		}
+		return;
+	}
+
+	int32_t twoA2 = 2 * (int32_t)_rx * _rx;
+	int32_t twoB2 = 2 * (int32_t)_ry * _ry;
+
+	int32_t x = _rx;
+	int32_t y = 0;
+	int32_t xChange = (int32_t)_ry * _ry * (1 - 2 * (int32_t)_rx);
+	int32_t yChange = (int32_t)_rx * _rx;
+	int32_t error = 0;
+	int32_t stopX = twoB2 * _rx;
+	int32_t stopY = 0;
+	while(stopX >= stopY){
+		shapeRow(y, x);
+		y++;
+		stopY += twoA2;
+		error += yChange;
+		yChange += twoA2;
+		if((2 * error + xChange) > 0){
+			x--;
+			stopX -= twoB2;
+			error += xChange;
+			xChange += twoB2;
+		}
+	}
+	int32_t done = y - 1; //last row drawn by part 1
+
+	x = 0;
+	y = _ry;
+	xChange = (int32_t)_ry * _ry;
+	yChange = (int32_t)_rx * _rx * (1 - 2 * (int32_t)_ry);
+	error = 0;
+	stopX = 0;
+	stopY = twoA2 * _ry;
+	while(stopX <= stopY){
+		x++;
+		stopX += twoB2;
+		error += xChange;
+		xChange += twoB2;
+		if((2 * error + yChange) > 0){
+			//row y is complete: x - 1 was its last point
+			if(y > done){
+				shapeRow(y, x - 1);
 			}
-			fontByte = fontByte << 1;
-			index++;
+			y--;
+			stopY -= twoA2;
+			error += yChange;
+			yChange += twoA2;
 		}
 	}
+	for(; y > done; y--){
+		shapeRow(y, x - 1);
+	}
 }
 
-void bitmap_characterBitmap5(uint16_t _x, uint16_t _y, char _character, uint8_t _color) {
-	uint8_t index = 0;
+//row _dy above and below the center rectangle, _half pixels wider than it on both sides
+static void shapeRow(uint16_t _dy, uint16_t _half){
+	int32_t top = shape.cy0 - _dy;
+	int32_t bottom = shape.cy1 + _dy;
 
-	for (uint8_t array = 0; array < 2; array++) {
-		uint16_t fontByte;
-		fontByte = FONT5x3[_character - 0x1F][array];
+	switch(shape.orthant){
+	case 0:
+		clipSpan(shape.cx0 - _half, shape.cx1 + _half, top, shape.color);
+		if(bottom != top){
+			clipSpan(shape.cx0 - _half, shape.cx1 + _half, bottom, shape.color);
+		}
+		break;
+	case 1:
+		if(_dy > 0){
+			clipSpan(shape.cx1 + 1, shape.cx1 + _half, top, shape.color);
+		}
+		break;
+	case 2:
+		if(_dy > 0){
+			clipSpan(shape.cx0 - _half, shape.cx0 - 1, top, shape.color);
+		}
+		break;
+	case 3:
+		if(_dy > 0){
+			clipSpan(shape.cx0 - _half, shape.cx0 - 1, bottom, shape.color);
+		}
+		break;
+	case 4:
+		if(_dy > 0){
+			clipSpan(shape.cx1 + 1, shape.cx1 + _half, bottom, shape.color);
+		}
+		break;
+	}
+}
+
+//Q14 unit vector of an angle in degree
+static void angleVector(uint16_t _angle, int32_t *_vx, int32_t *_vy){
+	uint16_t s = _angle % 360;
+	uint16_t c = (_angle + 90) % 360;
+	*_vy = (s <= 90) ? sinQ14[s] : (s <= 180) ? sinQ14[180 - s] : (s <= 270) ? -sinQ14[s - 180] : -sinQ14[360 - s];
+	*_vx = (c <= 90) ? sinQ14[c] : (c <= 180) ? sinQ14[180 - c] : (c <= 270) ? -sinQ14[c - 180] : -sinQ14[360 - c];
+}
 
-		for (uint8_t i = 0; i < 8; i++) {
-			if (fontByte & 0x80) {
-				bitmap_pixel(_x + (index % 3), _y + (index / 3), _color);
+//narrow _lo.._hi to the integers x with _a * x + _b >= 0
+static void halfPlane(int32_t _a, int32_t _b, int32_t *_lo, int32_t *_hi){
+	if(_a > 0){
+		//x >= ceil(-_b / _a)
+		int32_t t = (-_b >= 0) ? ((-_b + _a - 1) / _a) : -(_b / _a);
+		if(t > *_lo){
+			*_lo = t;
+		}
+	}else if(_a < 0){
+		//x <= floor(_b / -_a)
+		int32_t t = (_b >= 0) ? (_b / -_a) : -((-_b - _a - 1) / -_a);
+		if(t < *_hi){
+			*_hi = t;
+		}
+	}else if(_b < 0){
+		*_lo = 1;
+		*_hi = 0;
+	}
+}
+
+//ring segment _x0.._x1 of row _dy (downward), cut by the sector of arc
+static void arcRow(int32_t _x0, int32_t _x1, int32_t _dy){
+	int32_t y = arc.cy + _dy;
+	int32_t py = -_dy;
+
+	if(arc.sweep >= 360){
+		clipSpan(arc.cx + _x0, arc.cx + _x1, y, arc.color);
+		return;
+	}
+
+	int32_t lo = _x0;
+	int32_t hi = _x1;
+	if(arc.sweep <= 180){
+		//cross(A, P) >= 0, cross(P, B) >= 0, and the side of the bisector for narrow sectors
+		halfPlane(-arc.ay, arc.ax * py, &lo, &hi);
+		halfPlane(arc.by, -arc.bx * py, &lo, &hi);
+		if(arc.sweep < 180){
+			halfPlane(arc.ax + arc.bx, (arc.ay + arc.by) * py, &lo, &hi);
+		}
+		if(lo <= hi){
+			clipSpan(arc.cx + lo, arc.cx + hi, y, arc.color);
+		}
+		return;
+	}
+
+	//wide sector: the segment minus the open sector from B to A
+	lo = -0x7fff;
+	hi = 0x7fff;
+	halfPlane(arc.ay, -arc.ax * py - 1, &lo, &hi);
+	halfPlane(-arc.by, arc.bx * py - 1, &lo, &hi);
+	if(lo > hi){
+		clipSpan(arc.cx + _x0, arc.cx + _x1, y, arc.color);
+		return;
+	}
+	if(_x0 < lo){
+		clipSpan(arc.cx + _x0, arc.cx + ((_x1 < lo) ? _x1 : (lo - 1)), y, arc.color);
+	}
+	if(_x1 > hi){
+		clipSpan(arc.cx + ((_x0 > hi) ? _x0 : (hi + 1)), arc.cx + _x1, y, arc.color);
+	}
+}
+
+//memset-style fill: single pixels up to a 4 byte boundary, then 32bit stores
+static void spanFill(bitmap_color_t *_p, uint32_t _count, bitmap_color_t _color){
+	uint32_t word = colorWord(_color);
+	while((_count > 0) && ((uintptr_t)_p & 0x03)){
+		*_p++ = _color;
+		_count--;
+	}
+
+	uint32_t *w = (uint32_t *)_p;
+	uint32_t words = _count / (4 / sizeof(bitmap_color_t));
+	while(words >= 4){
+		w[0] = word;
+		w[1] = word;
+		w[2] = word;
+		w[3] = word;
+		w += 4;
+		words -= 4;
+	}
+	while(words--){
+		*w++ = word;
+	}
+
+	_p = (bitmap_color_t *)w;
+	for(_count %= (4 / sizeof(bitmap_color_t)); _count > 0; _count--){
+		*_p++ = _color;
+	}
+}
+
+//_color in every pixel of a 32bit word
+static inline uint32_t colorWord(bitmap_color_t _color){
+#if BITMAP_COLOR_FORMAT == BITMAP_RGB565
+	return ((uint32_t)_color << 16) | _color;
+#else
+	return (uint32_t)_color * 0x01010101;
+#endif
+}
+
+/*
+ * One font row (MSB is the left pixel), each pixel _size x _size.
+ * Size 1 inside the clip window: the 8 pixels through glyphMask, masked 32bit stores. The stores cover whole
+ * words around the row, so this needs a word aligned buffer and row length; otherwise spans are used.
+ * Otherwise runs of set bits, emitted row by row as spans.
+ */
+static void glyphRow(uint16_t _x, uint16_t _y, uint8_t _bits, uint8_t _size, bitmap_color_t _color){
+	if(_bits == 0){
+		return;
+	}
+	uint8_t aligned = ((((uintptr_t)bitmap_param.bitmap) | ((uint32_t)stride * sizeof(bitmap_color_t))) & 0x03) == 0;
+	if((bitmap_param.bitmap != NULL) && (_size == 1) && aligned && (_y >= win.y0) && (_y <= win.y1) && (_x >= win.x0) && (((int32_t)_x + 7) <= win.x1)){
+		bitmap_color_t *p = &bitmap_param.bitmap[((uint32_t)stride * (_y - view_top)) + _x];
+		uint32_t *w = (uint32_t *)((uintptr_t)p & ~(uintptr_t)0x03);
+		//row bits moved to the word boundary: the high byte covers GLYPH_WORDS words, the low byte one more
+		uint16_t bits = (uint16_t)_bits << (8 - (((uintptr_t)p & 0x03) / sizeof(bitmap_color_t)));
+		uint32_t word = colorWord(_color);
+		const uint32_t *mask = glyphMask[bits >> 8];
+		for(uint8_t i = 0; i < GLYPH_WORDS; i++){
+			if(mask[i]){
+				w[i] = (w[i] & ~mask[i]) | (word & mask[i]);
 			}
-			fontByte = fontByte << 1;
-			index++;
+		}
+		if(bits & 0xff){
+			mask = glyphMask[bits & 0xff];
+			w[GLYPH_WORDS] = (w[GLYPH_WORDS] & ~mask[0]) | (word & mask[0]);
+		}
+		return;
+	}
+
+	//at most 4 runs in 8 bits
+	uint16_t start[4];
+	uint16_t end[4];
+	uint8_t runs = 0;
+	uint16_t x = _x;
+	while(_bits){
+		if(_bits & 0x80){
+			start[runs] = x;
+			while(_bits & 0x80){
+				_bits <<= 1;
+				x += _size;
+			}
+			end[runs++] = x - 1;
+		}else{
+			_bits <<= 1;
+			x += _size;
+		}
+	}
+
+	if(bitmap_param.bitmap == NULL){
+		for(uint8_t r = 0; r < runs; r++){
+			directRect(start[r], _y, end[r], _y + _size - 1, _color);
+		}
+		return;
+	}
+	for(uint16_t y = _y; y < (_y + _size); y++){
+		for(uint8_t r = 0; r < runs; r++){
+			hspan(start[r], end[r], y, _color);
 		}
 	}
 }
 
-void bitmap_terminal(const char _character[], uint8_t _font, uint8_t _color, uint8_t _max_line){
-	if(bitmap_param.width == 0){
+static inline bitmap_color_t imageColor(const bitmap_image_t *_image, uint8_t _value){
+	return (_image->palette != NULL) ? _image->palette[_value] : BITMAP_COLOR8(_value);
+}
+
+//_count pixels of a packed source row from pixel _first on, into the framebuffer at _dst
+static void blitRow(bitmap_color_t *_dst, const uint8_t *_row, uint16_t _first, uint16_t _count, const bitmap_image_t *_image){
+	const bitmap_color_t *pal = _image->palette;
+	uint8_t keyed = (_image->flags & BITMAP_IMAGE_KEY) ? 1 : 0;
+	uint8_t key = _image->key;
+
+	if(_image->bpp == 8){
+		const uint8_t *src = _row + _first;
+		if(keyed){
+			for(; _count > 0; _count--){
+				uint8_t v = *src++;
+				if(v != key){
+					*_dst = imageColor(_image, v);
+				}
+				_dst++;
+			}
+			return;
+		}
+#if BITMAP_COLOR_FORMAT == BITMAP_RGB332
+		if(pal == NULL){
+			memcpy(_dst, src, _count);
+			return;
+		}
+#endif
+		if(pal != NULL){
+			while(_count >= 4){
+				_dst[0] = pal[src[0]];
+				_dst[1] = pal[src[1]];
+				_dst[2] = pal[src[2]];
+				_dst[3] = pal[src[3]];
+				_dst += 4;
+				src += 4;
+				_count -= 4;
+			}
+		}
+		for(; _count > 0; _count--){
+			*_dst++ = imageColor(_image, *src++);
+		}
 		return;
 	}
 
-	if(term_line >= _max_line){
-		uint16_t max_y = 8 * _max_line;
-		for(uint16_t y = 8; y < max_y; y++){
-			for(uint16_t x = 0; x < bitmap_param.width; x++){
-				bitmap_param.bitmap[(y - 8) * bitmap_param.width + x] = bitmap_param.bitmap[y * bitmap_param.width + x];
+	uint8_t bpp = _image->bpp;
+	uint8_t perByte = 8 / bpp;
+	const uint8_t *src = _row + (_first / perByte);
+	uint8_t bits = 0;
+	uint8_t left = 0; //pixels left in bits
+	if((_first % perByte) != 0){
+		bits = *src++ << ((_first % perByte) * bpp);
+		left = perByte - (_first % perByte);
+	}
+
+	while(_count > 0){
+		if(left == 0){
+			if(!keyed && (_count >= perByte)){
+				//whole source bytes
+				uint16_t n = _count / perByte;
+				_count -= n * perByte;
+				switch(bpp){
+				case 4:
+					for(; n > 0; n--){
+						uint8_t b = *src++;
+						bitmap_color_t c0 = pal[b >> 4];
+						bitmap_color_t c1 = pal[b & 0x0f];
+						_dst[0] = c0;
+						_dst[1] = c1;
+						_dst += 2;
+					}
+					break;
+				case 2:
+					for(; n > 0; n--){
+						uint8_t b = *src++;
+						bitmap_color_t c0 = pal[b >> 6];
+						bitmap_color_t c1 = pal[(b >> 4) & 0x03];
+						bitmap_color_t c2 = pal[(b >> 2) & 0x03];
+						bitmap_color_t c3 = pal[b & 0x03];
+						_dst[0] = c0;
+						_dst[1] = c1;
+						_dst[2] = c2;
+						_dst[3] = c3;
+						_dst += 4;
+					}
+					break;
+				default:
+					for(; n > 0; n--){
+						uint8_t b = *src++;
+						bitmap_color_t c0 = pal[0];
+						bitmap_color_t c1 = pal[1];
+						for(uint8_t k = 0; k < 8; k++){
+							_dst[k] = (b & 0x80) ? c1 : c0;
+							b <<= 1;
+						}
+						_dst += 8;
+					}
+					break;
+				}
+				continue;
 			}
+			bits = *src++;
+			left = perByte;
+		}
+		uint8_t v = bits >> (8 - bpp);
+		bits <<= bpp;
+		left--;
+		if(!keyed || (v != key)){
+			*_dst = pal[v];
+		}
+		_dst++;
+		_count--;
+	}
+}
+
+//same for the direct target: runs of one color become one rectangle
+static void blitDirect(int32_t _x, int32_t _y, const uint8_t *_row, uint16_t _first, uint16_t _count, const bitmap_image_t *_image){
+	uint8_t bpp = _image->bpp;
+	uint8_t keyed = (_image->flags & BITMAP_IMAGE_KEY) ? 1 : 0;
+	int32_t start = 0;
+	uint8_t runValue = 0;
+	uint8_t inRun = 0;
+	for(uint16_t i = 0; i <= _count; i++){
+		uint8_t v = 0;
+		uint8_t draw = 0;
+		if(i < _count){
+			uint32_t bit = (uint32_t)(_first + i) * bpp;
+			v = (_row[bit >> 3] >> (8 - bpp - (bit & 7))) & ((1 << bpp) - 1);
+			draw = !keyed || (v != _image->key);
+		}
+		if(inRun && (!draw || (v != runValue))){
+			directRect(_x + start, _y, _x + i - 1, _y, imageColor(_image, runValue));
+			inRun = 0;
+		}
+		if(draw && !inRun){
+			start = i;
+			runValue = v;
+			inRun = 1;
 		}
+	}
+}
+
+static uint16_t read16(const uint8_t *_p){
+	return _p[0] | (_p[1] << 8);
+}
+
+static uint32_t read32(const uint8_t *_p){
+	return _p[0] | (_p[1] << 8) | ((uint32_t)_p[2] << 16) | ((uint32_t)_p[3] << 24);
+}
 
-		for(uint16_t y = (max_y - 8); y < max_y; y++){
-			for(uint16_t x = 0; x < bitmap_param.width; x++){
-				bitmap_param.bitmap[y * bitmap_param.width + x] = bitmap_param.background;
+//next _bytes bytes of the RLE stream
+static void rleRow(uint8_t *_out, uint16_t _bytes){
+	while(_bytes > 0){
+		if(rle.count == 0){
+			uint8_t n = *rle.p++;
+			rle.repeat = n & 0x80;
+			rle.count = (n & 0x7f) + 1;
+			if(rle.repeat){
+				rle.value = *rle.p++;
 			}
 		}
-		term_line = _max_line - 1;
+		uint8_t n = (rle.count < _bytes) ? rle.count : _bytes;
+		if(rle.repeat){
+			memset(_out, rle.value, n);
+		}else{
+			memcpy(_out, rle.p, n);
+			rle.p += n;
+		}
+		_out += n;
+		_bytes -= n;
+		rle.count -= n;
 	}
+}
+
+static uint8_t recording(){
+	return (bitmap_list.cmd != NULL) && (bitmap_list.replay == 0) && (surface == NULL);
+}
 
+//append a command covering rows _top to _bottom. NULL when it is off the screen or the list is full
+static bitmap_cmd_t *record(uint8_t _type, int32_t _top, int32_t _bottom, bitmap_color_t _color, uint16_t _p0, uint16_t _p1, uint16_t _p2, uint16_t _p3, uint16_t _p4, uint16_t _p5){
+	if(_top > _bottom){
+		int32_t tmp = _top;
+		_top = _bottom;
+		_bottom = tmp;
+	}
+	if((_bottom < 0) || (_top >= bitmap_param.height)){
+		return NULL;
+	}
+	if((_type != CMD_PUSHCLIP) && (_type != CMD_POPCLIP) && ((_bottom < win.y0) || (_top > win.y1))){
+		return NULL;
+	}
+	if(bitmap_list.count >= bitmap_list.size){
+		bitmap_list.overflow = 1;
+		return NULL;
+	}
+
+	bitmap_cmd_t *cmd = &bitmap_list.cmd[bitmap_list.count++];
+	cmd->type = _type;
+	cmd->color = _color;
+	cmd->top = (_top < 0) ? 0 : _top;
+	cmd->bottom = (_bottom >= bitmap_param.height) ? (bitmap_param.height - 1) : _bottom;
+	cmd->p[0] = _p0;
+	cmd->p[1] = _p1;
+	cmd->p[2] = _p2;
+	cmd->p[3] = _p3;
+	cmd->p[4] = _p4;
+	cmd->p[5] = _p5;
+	return cmd;
+}
+
+static void terminalLine(const char _character[], uint8_t _font, bitmap_color_t _color, uint16_t _line){
 	uint8_t c = 0;
 	while (_character[c]) {
-		bitmap_characterBitmap8((c * 8), (term_line * 8), _character[c], 1, _font, _color);
+		bitmap_characterBitmap8((c * 8), (_line * 8), _character[c], 1, _font, _color);
 		if((++c * 8 + 8) > bitmap_param.width){
 			break;
 		}
 	}
+}
 
-	term_line++;
+
+/*
+ * Draw _image with its top left corner at _x,_y, clipped.
+ * 8bpp rows without key are copied 4 pixels per step (memcpy for an RGB332 framebuffer without palette),
+ * 1/2/4bpp rows a whole source byte per step.
+ */
+void bitmap_blit(const bitmap_image_t *_image, uint16_t _x, uint16_t _y){
+	if((bitmap_param.width == 0) || (_image == NULL) || (_image->width == 0) || (_image->height == 0)){
+		return;
+	}
+	if((_image->bpp != 1) && (_image->bpp != 2) && (_image->bpp != 4) && (_image->bpp != 8)){
+		return;
+	}
+	if((_image->bpp != 8) && (_image->palette == NULL)){
+		return;
+	}
+	int32_t x1 = (int32_t)_x + _image->width - 1;
+	int32_t y1 = (int32_t)_y + _image->height - 1;
+	if(clipReject(_x, _y, x1, y1)){
+		return;
+	}
+	if(recording()){
+		bitmap_cmd_t *cmd = record(CMD_BLIT, _y, y1, 0, _x, _y, 0, 0, 0, 0);
+		if(cmd != NULL){
+			cmd->src.image = _image;
+		}
+		return;
+	}
+
+	uint16_t rowBytes = ((uint32_t)_image->width * _image->bpp + 7) / 8;
+	uint8_t rleOn = (_image->flags & BITMAP_IMAGE_RLE) ? 1 : 0;
+	if(rleOn && (rowBytes > BITMAP_RLE_ROW_MAX)){
+		return;
+	}
+	rle.p = _image->data;
+	rle.count = 0;
+
+	//visible source columns and rows
+	uint16_t first = (win.x0 > _x) ? (win.x0 - _x) : 0;
+	uint16_t last = (win.x1 < x1) ? (win.x1 - _x) : (_image->width - 1);
+	uint16_t top = (win.y0 > _y) ? (win.y0 - _y) : 0;
+	uint16_t bottom = (win.y1 < y1) ? (win.y1 - _y) : (_image->height - 1);
+
+	dirtyBegin(_x, _y, x1, y1);
+	for(uint16_t y = 0; y <= bottom; y++){
+		const uint8_t *row;
+		if(rleOn){
+			//rows above the clip rectangle still have to be decoded
+			rleRow(rle.row, rowBytes);
+			row = rle.row;
+		}else{
+			row = &_image->data[(uint32_t)rowBytes * y];
+		}
+		if(y < top){
+			continue;
+		}
+		if(bitmap_param.bitmap == NULL){
+			blitDirect((int32_t)_x + first, (int32_t)_y + y, row, first, last - first + 1, _image);
+		}else{
+			bitmap_color_t *dst = &bitmap_param.bitmap[((uint32_t)(_y + y - view_top) * stride) + _x + first];
+			blitRow(dst, row, first, last - first + 1, _image);
+		}
+	}
+	dirtyEnd();
+}
+
+/*
+ * Copy the surface _src with its top left corner at _x,_y, clipped, e.g. static content drawn once with the bitmap_surface* functions.
+ * Rows are copied with memcpy. Without a framebuffer, each row goes to the panel as runs of one color.
+ * _src must not be the target itself.
+ */
+void bitmap_blitSurface(const bitmap_surface_t *_src, uint16_t _x, uint16_t _y){
+	if((bitmap_param.width == 0) || (_src == NULL) || (_src->bitmap == NULL) || (_src->width == 0) || (_src->height == 0)){
+		return;
+	}
+	int32_t x1 = (int32_t)_x + _src->width - 1;
+	int32_t y1 = (int32_t)_y + _src->height - 1;
+	if(clipReject(_x, _y, x1, y1)){
+		return;
+	}
+	if(recording()){
+		bitmap_cmd_t *cmd = record(CMD_BLITSURFACE, _y, y1, 0, _x, _y, 0, 0, 0, 0);
+		if(cmd != NULL){
+			cmd->src.surface = _src;
+		}
+		return;
+	}
+
+	//visible source columns and rows
+	uint16_t first = (win.x0 > _x) ? (win.x0 - _x) : 0;
+	uint16_t last = (win.x1 < x1) ? (win.x1 - _x) : (_src->width - 1);
+	uint16_t top = (win.y0 > _y) ? (win.y0 - _y) : 0;
+	uint16_t bottom = (win.y1 < y1) ? (win.y1 - _y) : (_src->height - 1);
+
+	dirtyBegin(_x, _y, x1, y1);
+	for(uint32_t y = top; y <= bottom; y++){
+		const bitmap_color_t *row = &_src->bitmap[y * _src->stride];
+		if(bitmap_param.bitmap == NULL){
+			uint32_t start = first;
+			for(uint32_t x = first + 1; x <= ((uint32_t)last + 1); x++){
+				if((x > last) || (row[x] != row[start])){
+					directRect((int32_t)_x + start, (int32_t)_y + y, (int32_t)_x + x - 1, (int32_t)_y + y, row[start]);
+					start = x;
+				}
+			}
+		}else{
+			memcpy(&bitmap_param.bitmap[((_y + y - view_top) * stride) + _x + first], &row[first], ((uint32_t)last - first + 1) * sizeof(bitmap_color_t));
+		}
+	}
+	dirtyEnd();
+}
+
+//4bit frame, two pixels per byte: an unkeyed bitmap_blit with _color_map as palette
+void bitmap_animation_4bit(const uint8_t* _frame, const bitmap_color_t* _color_map, uint16_t _print_x, uint16_t _print_y, uint16_t _array_size_x, uint16_t _array_size_y){
+	if(recording()){
+		if(clipReject(_print_x, _print_y, (int32_t)_print_x + (2 * _array_size_x) - 1, (int32_t)_print_y + _array_size_y - 1)){
+			return;
+		}
+		bitmap_cmd_t *cmd = record(CMD_ANIMATION4, _print_y, (int32_t)_print_y + _array_size_y - 1, 0, _print_x, _print_y, _array_size_x, _array_size_y, 0, 0);
+		if(cmd != NULL){
+			cmd->src.animation.frame = _frame;
+			cmd->src.animation.map = _color_map;
+		}
+		return;
+	}
+
+	bitmap_image_t image = {2 * _array_size_x, _array_size_y, 4, 0, 0, _frame, _color_map};
+	bitmap_blit(&image, _print_x, _print_y);
 }
 
+/*
+ * Delta animation player. Keyframes are RLE blits, delta frames only rewrite the spans that changed,
+ * so the framebuffer (or the GRAM in direct mode) has to keep the previous frame. Not recorded in display lists.
+ */
+uint8_t bitmap_animationOpen(bitmap_animation_t *_anim, const uint8_t *_stream, const bitmap_color_t *_palette, uint16_t _x, uint16_t _y){
+	if((_stream[0] != 'D') || (_stream[1] != 'A')){
+		return 0;
+	}
+	_anim->stream = _stream;
+	_anim->width = read16(&_stream[2]);
+	_anim->height = read16(&_stream[4]);
+	_anim->records = read16(&_stream[6]);
+	_anim->loopRecord = read16(&_stream[8]);
+	_anim->palette = _palette;
+	_anim->x = _x;
+	_anim->y = _y;
+	if((_anim->records == 0) || (_anim->loopRecord >= _anim->records) || (_stream[10] != 0)){
+		//the first record has to be a keyframe
+		return 0;
+	}
+
+	const uint8_t *p = &_stream[10];
+	for(uint16_t i = 0; i < _anim->loopRecord; i++){
+		p += 5 + read32(&p[1]);
+	}
+	_anim->loop = p;
+	_anim->next = &_stream[10];
+	_anim->record = 0;
+	return 1;
+}
 
-void bitmap_animation_4bit(const uint8_t* _frame, const uint8_t* _color_map, uint16_t _print_x, uint16_t _print_y, uint16_t _array_size_x, uint16_t _array_size_y){
-	const uint8_t *p_frame = _frame;
-	for(uint16_t y = 0; y < _array_size_y; y++){
-		uint8_t *p_bitmap = &bitmap_param.bitmap[((_print_y + y) * bitmap_param.width) + _print_x];
-		for(uint16_t x = 0; x < _array_size_x; x++){
-			uint8_t frame = *p_frame++;
-			uint8_t col1 = _color_map[(frame >> 4)];
-			uint8_t col2 = _color_map[(frame & 0b00001111)];
+//draw the next frame. Returns 1 when pixels changed, _anim->changed holds their screen area
+uint8_t bitmap_animationNext(bitmap_animation_t *_anim){
+	if((bitmap_param.width == 0) || recording()){
+		return 0;
+	}
+	if(_anim->record >= _anim->records){
+		_anim->next = _anim->loop;
+		_anim->record = _anim->loopRecord;
+	}
 
-			*p_bitmap++ = col1;
-			*p_bitmap++ = col2;
+	const uint8_t *p = _anim->next;
+	uint8_t type = p[0];
+	uint32_t size = read32(&p[1]);
+	p += 5;
+	_anim->next = p + size;
+	_anim->record++;
+
+	int32_t x0, y0, x1, y1;
+	if(type == 0){
+		x0 = 0;
+		y0 = 0;
+		x1 = _anim->width - 1;
+		y1 = _anim->height - 1;
+	}else{
+		x0 = read16(&p[0]);
+		y0 = read16(&p[2]);
+		x1 = read16(&p[4]);
+		y1 = read16(&p[6]);
+	}
+	//changed area on the screen, inside the clip rectangle
+	x0 += _anim->x;
+	y0 += _anim->y;
+	x1 += _anim->x;
+	y1 += _anim->y;
+	if((x0 > x1) || (y0 > y1) || (x1 < clip.rect.x0) || (x0 > clip.rect.x1) || (y1 < clip.rect.y0) || (y0 > clip.rect.y1)){
+		return 0;
+	}
+	_anim->changed.x0 = (x0 < clip.rect.x0) ? clip.rect.x0 : x0;
+	_anim->changed.y0 = (y0 < clip.rect.y0) ? clip.rect.y0 : y0;
+	_anim->changed.x1 = (x1 > clip.rect.x1) ? clip.rect.x1 : x1;
+	_anim->changed.y1 = (y1 > clip.rect.y1) ? clip.rect.y1 : y1;
+
+	if(type == 0){
+		bitmap_image_t image = {_anim->width, _anim->height, 8, BITMAP_IMAGE_RLE, 0, p, _anim->palette};
+		bitmap_blit(&image, _anim->x, _anim->y);
+		return 1;
+	}
+
+	dirtyBegin(x0, y0, x1, y1);
+	uint16_t spans = read16(&p[8]);
+	p += 10;
+	uint32_t pos = 0;
+	for(; spans > 0; spans--){
+		//LEB128 skip
+		uint32_t skip = 0;
+		uint8_t shift = 0;
+		while(*p & 0x80){
+			skip |= (uint32_t)(*p++ & 0x7f) << shift;
+			shift += 7;
+		}
+		skip |= (uint32_t)(*p++) << shift;
+		pos += skip;
+
+		uint8_t n = *p++;
+		uint8_t count = (n & 0x7f) + 1;
+		int32_t x = _anim->x + (pos % _anim->width);
+		int32_t y = _anim->y + (pos / _anim->width);
+		if(n & 0x80){
+			bitmap_color_t color = (_anim->palette != NULL) ? _anim->palette[*p] : BITMAP_COLOR8(*p);
+			clipSpan(x, x + count - 1, y, color);
+			p++;
+		}else{
+			if(!clipReject(x, y, x + count - 1, y)){
+				bitmap_image_t image = {count, 1, 8, 0, 0, p, _anim->palette};
+				bitmap_blit(&image, x, y);
+			}
+			p += count;
 		}
+		pos += count;
+	}
+	dirtyEnd();
+	return 1;
+}
+
+/*
+ * Off-screen surfaces: a bitmap_surface* call binds the surface as the drawing target for that call only,
+ * with a clip of the whole surface. The screen's clip stack, dirty rectangles and display list are left alone.
+ * _stride: pixels from one row to the next, 0: _width (a stride larger than the width draws into part of a bigger buffer).
+ */
+void bitmap_surfaceInit(bitmap_surface_t *_surface, bitmap_color_t *_bitmap, uint16_t _width, uint16_t _height, uint16_t _stride, bitmap_color_t _background){
+	_surface->bitmap = _bitmap;
+	_surface->width = _width;
+	_surface->height = _height;
+	_surface->stride = (_stride == 0) ? _width : _stride;
+	_surface->background = _background;
+}
+
+void bitmap_surfacePixel(bitmap_surface_t *_surface, uint16_t _x, uint16_t _y, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_pixel(_x, _y, _color);
+		surfaceEnd(&keep);
 	}
 }
 
+void bitmap_surfaceClear(bitmap_surface_t *_surface){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_clear();
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceLine(bitmap_surface_t *_surface, uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_line(_x0, _y0, _x1, _y1, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceThickline(bitmap_surface_t *_surface, uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint16_t _width, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_thickline(_x0, _y0, _x1, _y1, _width, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceBezier(bitmap_surface_t *_surface, uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint16_t _x2, uint16_t _y2, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_bezier(_x0, _y0, _x1, _y1, _x2, _y2, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceHspan(bitmap_surface_t *_surface, uint16_t _x0, uint16_t _x1, uint16_t _y, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_hspan(_x0, _x1, _y, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceRect(bitmap_surface_t *_surface, uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint16_t _width, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_rect(_x0, _y0, _x1, _y1, _width, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceFillrect(bitmap_surface_t *_surface, uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_fillrect(_x0, _y0, _x1, _y1, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceCircle(bitmap_surface_t *_surface, uint16_t _x, uint16_t _y, uint16_t _round, uint16_t _orthant, uint16_t _width, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_circle(_x, _y, _round, _orthant, _width, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceFillcircle(bitmap_surface_t *_surface, uint16_t _x, uint16_t _y, uint16_t _round, uint16_t _orthant, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_fillcircle(_x, _y, _round, _orthant, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceFillellipse(bitmap_surface_t *_surface, uint16_t _x, uint16_t _y, uint16_t _rx, uint16_t _ry, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_fillellipse(_x, _y, _rx, _ry, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceArc(bitmap_surface_t *_surface, uint16_t _x, uint16_t _y, uint16_t _round, uint16_t _startAngle, uint16_t _stopAngle, uint16_t _width, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_arc(_x, _y, _round, _startAngle, _stopAngle, _width, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceFillarc(bitmap_surface_t *_surface, uint16_t _x, uint16_t _y, uint16_t _inner, uint16_t _outer, uint16_t _startAngle, uint16_t _stopAngle, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_fillarc(_x, _y, _inner, _outer, _startAngle, _stopAngle, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceRoundrect(bitmap_surface_t *_surface, uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint16_t _round, uint16_t _width, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_roundrect(_x0, _y0, _x1, _y1, _round, _width, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceFillroundrect(bitmap_surface_t *_surface, uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1, uint16_t _round, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_fillroundrect(_x0, _y0, _x1, _y1, _round, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceStringBitmap(bitmap_surface_t *_surface, uint16_t _x, uint16_t _y, const char _character[], uint8_t _size, uint8_t _font, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_stringBitmap(_x, _y, _character, _size, _font, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceCharacterBitmap8(bitmap_surface_t *_surface, uint16_t _x, uint16_t _y, char _character, uint8_t _size, uint8_t _font, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_characterBitmap8(_x, _y, _character, _size, _font, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceCharacterBitmap5(bitmap_surface_t *_surface, uint16_t _x, uint16_t _y, char _character, bitmap_color_t _color){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_characterBitmap5(_x, _y, _character, _color);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceBlit(bitmap_surface_t *_surface, const bitmap_image_t *_image, uint16_t _x, uint16_t _y){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_blit(_image, _x, _y);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceBlitSurface(bitmap_surface_t *_surface, const bitmap_surface_t *_src, uint16_t _x, uint16_t _y){
+	struct target_t keep;
+	if((_src != _surface) && surfaceBegin(_surface, &keep)){
+		bitmap_blitSurface(_src, _x, _y);
+		surfaceEnd(&keep);
+	}
+}
+
+void bitmap_surfaceAnimation_4bit(bitmap_surface_t *_surface, const uint8_t* _frame, const bitmap_color_t* _color_map, uint16_t _print_x, uint16_t _print_y, uint16_t _array_size_x, uint16_t _array_size_y){
+	struct target_t keep;
+	if(surfaceBegin(_surface, &keep)){
+		bitmap_animation_4bit(_frame, _color_map, _print_x, _print_y, _array_size_x, _array_size_y);
+		surfaceEnd(&keep);
+	}
+}
+
+uint8_t bitmap_surfaceAnimationNext(bitmap_surface_t *_surface, bitmap_animation_t *_anim){
+	struct target_t keep;
+	uint8_t result = 0;
+	if(surfaceBegin(_surface, &keep)){
+		result = bitmap_animationNext(_anim);
+		surfaceEnd(&keep);
+	}
+	return result;
+}
+
+//bind _surface as the drawing target, the current one is saved in _keep. 0: not a usable surface
+static uint8_t surfaceBegin(bitmap_surface_t *_surface, struct target_t *_keep){
+	if((_surface == NULL) || (_surface->bitmap == NULL) || (_surface->width == 0) || (_surface->height == 0) || (_surface->stride < _surface->width)){
+		return 0;
+	}
+	_keep->param = bitmap_param;
+	_keep->direct = direct;
+	_keep->surface = surface;
+	_keep->stride = stride;
+	_keep->view_top = view_top;
+	_keep->view_lines = view_lines;
+	_keep->clip = clip.rect;
+	_keep->depth = clip.depth;
+
+	bitmap_param.width = _surface->width;
+	bitmap_param.height = _surface->height;
+	bitmap_param.background = _surface->background;
+	bitmap_param.bitmap = _surface->bitmap;
+	direct = NULL;
+	surface = _surface;
+	stride = _surface->stride;
+	view_top = 0;
+	view_lines = _surface->height;
+	clipReset();
+	return 1;
+}
+
+static void surfaceEnd(const struct target_t *_keep){
+	bitmap_param = _keep->param;
+	direct = _keep->direct;
+	surface = _keep->surface;
+	stride = _keep->stride;
+	view_top = _keep->view_top;
+	view_lines = _keep->view_lines;
+	clip.rect = _keep->clip;
+	clip.depth = _keep->depth;
+	clipUpdate();
+}
+
 //--------
 const unsigned char FONT8x8[][97][8] = {
 	{
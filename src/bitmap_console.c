@@ -0,0 +1,187 @@
+/*
+ * bitmap_console.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: k-omura
+ *
+ * Printing only changes cells and sets their dirty bits, console_render() draws the dirty cells.
+ * A new line at the bottom moves the ring origin and clears one row instead of copying the text up.
+ */
+
+#include "bitmap_console.h"
+#include <string.h>
+
+//private function prototype
+static void newLine(console_t*);
+static void putCell(console_t*, uint16_t, uint16_t, char, bitmap_color_t);
+static void markDirty(console_t*, uint16_t, uint16_t);
+static uint16_t ringRow(console_t*, uint16_t);
+//private function prototype end
+
+/*
+ * _cells: _cols * _rows chars, _colors: _cols * _rows colors or NULL, _dirty: CONSOLE_DIRTY_BYTES(_cols, _rows).
+ * The console covers _cols * 8 x _rows * 8 pixels from _x,_y.
+ */
+void console_init(console_t *_con, char *_cells, bitmap_color_t *_colors, uint8_t *_dirty, uint16_t _cols, uint16_t _rows, uint16_t _x, uint16_t _y, uint8_t _font, uint8_t _ring){
+	_con->cells = _cells;
+	_con->colors = _colors;
+	_con->dirty = _dirty;
+	_con->cols = _cols;
+	_con->rows = _rows;
+	_con->x = _x;
+	_con->y = _y;
+	_con->font = _font;
+	_con->ring = _ring;
+	_con->color = BITMAP_COLOR8(0xff);
+	_con->background = bitmap_param.background;
+	console_clear(_con);
+}
+
+//color of the following text. _background is used for every cell
+void console_setColor(console_t *_con, bitmap_color_t _color, bitmap_color_t _background){
+	_con->color = _color;
+	if(_background != _con->background){
+		_con->background = _background;
+		console_invalidate(_con);
+	}
+}
+
+//'\n' starts a new line, '\r' returns to the first column, long lines wrap
+void console_print(console_t *_con, const char *_text){
+	while(*_text){
+		char c = *_text++;
+		if(c == '\n'){
+			newLine(_con);
+			continue;
+		}
+		if(c == '\r'){
+			_con->col = 0;
+			continue;
+		}
+		if(_con->col >= _con->cols){
+			newLine(_con);
+		}
+		putCell(_con, _con->row, _con->col, c, _con->color);
+		_con->col++;
+	}
+}
+
+void console_clear(console_t *_con){
+	memset(_con->cells, ' ', (uint32_t)_con->cols * _con->rows);
+	_con->origin = 0;
+	_con->row = 0;
+	_con->col = 0;
+	console_invalidate(_con);
+}
+
+//draw every cell again with the next console_render(), e.g. after bitmap_clear()
+void console_invalidate(console_t *_con){
+	memset(_con->dirty, 0xff, CONSOLE_DIRTY_BYTES(_con->cols, _con->rows));
+}
+
+//draw the dirty cells. Returns the number of cells drawn
+uint16_t console_render(console_t *_con){
+	uint32_t cells = (uint32_t)_con->cols * _con->rows;
+	uint16_t drawn = 0;
+	for(uint32_t i = 0; i < cells; i++){
+		if(_con->dirty[i >> 3] == 0){
+			//skip 8 clean cells
+			i |= 7;
+			continue;
+		}
+		if((_con->dirty[i >> 3] & (1 << (i & 7))) == 0){
+			continue;
+		}
+		_con->dirty[i >> 3] &= ~(1 << (i & 7));
+
+		//position on the screen -> cell in the ring
+		uint16_t position = i / _con->cols;
+		uint16_t col = i % _con->cols;
+		uint16_t ring = _con->ring ? position : ringRow(_con, position);
+		uint32_t cell = (uint32_t)ring * _con->cols + col;
+		uint16_t x = _con->x + (col * 8);
+		uint16_t y = _con->y + (position * 8);
+
+		bitmap_fillrect(x, y, x + 7, y + 7, _con->background);
+		if(_con->cells[cell] != ' '){
+			bitmap_characterBitmap8(x, y, _con->cells[cell], 1, _con->font, (_con->colors != NULL) ? _con->colors[cell] : _con->color);
+		}
+		drawn++;
+	}
+	return drawn;
+}
+
+//ring mode: scroll offset in pixels that shows the oldest row at the top (ILI9341_setScrollOffset)
+uint16_t console_scrollOffset(console_t *_con){
+	return _con->ring ? (_con->origin * 8) : 0;
+}
+
+static void newLine(console_t *_con){
+	_con->col = 0;
+	if((_con->row + 1) < _con->rows){
+		_con->row++;
+		return;
+	}
+
+	//the top ring row becomes the new, empty bottom row
+	uint16_t top = _con->origin;
+	char *oldTop = &_con->cells[(uint32_t)top * _con->cols];
+	if(_con->ring){
+		//rows do not move on the screen: only the reused row changes
+		for(uint16_t c = 0; c < _con->cols; c++){
+			if(oldTop[c] != ' '){
+				oldTop[c] = ' ';
+				markDirty(_con, top, c);
+			}
+		}
+		_con->origin = (top + 1) % _con->rows;
+		return;
+	}
+
+	//every screen row will show the ring row below it: redraw only cells that look different
+	for(uint16_t r = 0; r < _con->rows; r++){
+		uint32_t before = (uint32_t)ringRow(_con, r) * _con->cols;
+		uint32_t now = (uint32_t)ringRow(_con, r + 1) * _con->cols;
+		for(uint16_t c = 0; c < _con->cols; c++){
+			char shown = _con->cells[before + c];
+			if((r + 1) == _con->rows){
+				//the new row is empty
+				if(shown != ' '){
+					markDirty(_con, r, c);
+				}
+			}else if((_con->cells[now + c] != shown) || ((_con->colors != NULL) && (shown != ' ') && (_con->colors[now + c] != _con->colors[before + c]))){
+				markDirty(_con, r, c);
+			}
+		}
+	}
+	memset(oldTop, ' ', _con->cols);
+	_con->origin = (top + 1) % _con->rows;
+}
+
+static void putCell(console_t *_con, uint16_t _row, uint16_t _col, char _c, bitmap_color_t _color){
+	if((_c < 0x20) || (_c > 0x7f)){
+		_c = ' ';
+	}
+	uint16_t ring = ringRow(_con, _row);
+	uint32_t cell = (uint32_t)ring * _con->cols + _col;
+	if((_con->cells[cell] == _c) && ((_con->colors == NULL) || (_con->colors[cell] == _color))){
+		return;
+	}
+	_con->cells[cell] = _c;
+	if(_con->colors != NULL){
+		_con->colors[cell] = _color;
+	}
+	markDirty(_con, _con->ring ? ring : _row, _col);
+}
+
+//_position: row on the screen (ring row in ring mode)
+static void markDirty(console_t *_con, uint16_t _position, uint16_t _col){
+	uint32_t i = (uint32_t)_position * _con->cols + _col;
+	_con->dirty[i >> 3] |= 1 << (i & 7);
+}
+
+//ring row shown in screen row _row
+static uint16_t ringRow(console_t *_con, uint16_t _row){
+	uint16_t ring = _con->origin + _row;
+	return (ring >= _con->rows) ? (ring - _con->rows) : ring;
+}
@@ -28,8 +28,8 @@ struct bitmap_truetype_param_t{
 	uint16_t displayHeight;
 	uint16_t displayWidthFrame;
 	uint8_t stringRotation;
-	uint8_t colorLine;
-	uint8_t colorInside;
+	bitmap_color_t colorLine;
+	bitmap_color_t colorInside;
 	uint8_t fillInside;
 };
 
@@ -85,7 +85,7 @@ typedef struct {
 	uint16_t scale_y;
 } ttGlyphTransformation_t;
 
-/* currently only support format4 cmap tables */
+/* format4 (BMP) and format12 (full Unicode) cmap tables */
 typedef struct {
 	uint16_t version;
 	uint16_t numberSubtables;
@@ -111,8 +111,21 @@ typedef struct {
 	uint32_t idDeltaOffset;
 	uint32_t idRangeOffsetOffset;
 	uint32_t glyphIndexArrayOffset;
+	uint16_t *endCode; //segment arrays in RAM, one malloc
+	uint16_t *startCode;
+	int16_t *idDelta;
+	uint16_t *idRangeOffset;
 } ttCmapFormat4_t;
 
+typedef struct {
+	uint16_t format;
+	uint32_t length;
+	uint32_t language;
+	uint32_t numGroups; //0: not used
+	uint32_t offset;
+	uint32_t groupsOffset; //startCharCode, endCharCode, startGlyphID (uint32 each) per group
+} ttCmapFormat12_t;
+
 /* currently only support format0 kerning tables */
 typedef struct {
 	uint32_t version; //The version number of the kerning table (0x00010000 for the current version).
@@ -146,6 +159,24 @@ typedef struct {
 	uint16_t p2;
 	uint8_t up;
 } ttWindIntersect_t;
+
+typedef struct {
+	uint32_t block; //file offset / TRUETYPE_CACHE_BLOCK_SIZE, 0xffffffff: empty
+	uint32_t used; //LRU stamp
+	uint16_t length; //valid bytes (less at the end of the file)
+	uint8_t data[TRUETYPE_CACHE_BLOCK_SIZE];
+} ttCacheBlock_t;
+
+typedef struct {
+	uint8_t *mask; //outline plane, then inside plane (1bpp, MSB first). NULL: empty
+	uint32_t used; //LRU stamp
+	uint16_t glyphId;
+	uint16_t metricCode; //glyph the metrics were read from (compound glyphs can use a component's)
+	uint16_t characterSize;
+	uint8_t rotation;
+	uint16_t width;
+	ttHMetric_t hMetric;
+} ttGlyphCache_t;
 //private struct typedef end
 
 
@@ -164,6 +195,8 @@ int16_t xMin, xMax, yMin, yMax;
 ttCmapIndex_t cmapIndex;
 ttCmapEncoding_t *cmapEncoding;
 ttCmapFormat4_t cmapFormat4;
+ttCmapFormat12_t cmapFormat12;
+uint16_t cmapAscii[128]; //glyph id of each ASCII code
 
 uint32_t hmtxTablePos = 0;
 
@@ -183,8 +216,29 @@ uint16_t *endPoints;
 uint16_t numEndPoints;
 ttWindIntersect_t *pointsToFill;
 
+#if TRUETYPE_USE_FATFS
 struct bitmap_truetype_fs_t bitmap_truetype_fs;
-struct bitmap_truetype_param_t bitmap_truetype_param = {20, 1, 0, 10, 280, 320, 280, 320, 280, 0, 0x00, 0xff};
+#endif
+struct bitmap_truetype_cache_t bitmap_truetype_cache = {0, 0, 0};
+
+//the parser reads at readPosition: straight from ttfMemory, or from the file through the block cache
+uint32_t readPosition = 0;
+const uint8_t *ttfMemory = NULL;
+uint32_t ttfLength = 0;
+#if TRUETYPE_USE_FATFS
+ttCacheBlock_t cacheBlock[TRUETYPE_CACHE_BLOCKS];
+ttCacheBlock_t *cacheCurrent = NULL; //block of the last read
+uint32_t cacheClock = 0;
+uint32_t cacheLastMiss = 0xffffffff;
+#endif
+
+//rasterized glyphs: drawn as masks with the current colors, so colors and fill are not part of the key
+struct bitmap_truetype_glyphCache_t bitmap_truetype_glyphCache = {0, 0, 0, 0};
+ttGlyphCache_t glyphCache[TRUETYPE_GLYPH_CACHE_ENTRIES];
+uint32_t glyphCacheBudget = TRUETYPE_GLYPH_CACHE_BUDGET;
+uint32_t glyphCacheClock = 0;
+bitmap_surface_t *glyphTarget = NULL; //outline and fill go here instead of the screen while rasterizing
+struct bitmap_truetype_param_t bitmap_truetype_param = {20, 1, 0, 10, 280, 320, 280, 320, 280, 0, BITMAP_COLOR8(0x00), BITMAP_COLOR8(0xff)};
 //private variable end
 
 //private function prototype
@@ -193,12 +247,29 @@ uint8_t getUInt8t();
 int16_t getInt16t();
 uint16_t getUInt16t();
 uint32_t getUInt32t();
+const uint8_t *readPointer(uint8_t);
+void setReadPosition(uint32_t);
+uint32_t getReadPosition();
+void readBytes(uint8_t*, uint32_t);
+void readU16Array(uint16_t*, uint16_t);
+void cacheReset();
+#if TRUETYPE_USE_FATFS
+ttCacheBlock_t *cacheGet(uint32_t);
+ttCacheBlock_t *cacheLoad(uint32_t);
+#endif
 int32_t map(int32_t, int32_t, int32_t, int32_t, int32_t);
+void glyphCacheClear();
+void glyphCacheFree(ttGlyphCache_t*);
+ttGlyphCache_t *glyphCacheFind(uint16_t);
+ttGlyphCache_t *glyphCacheAdd(uint16_t, uint16_t, ttHMetric_t);
+void glyphCachePlane(bitmap_color_t*, uint8_t*, uint16_t, uint16_t);
+void glyphCacheDraw(ttGlyphCache_t*, int32_t, int32_t);
 //int16_t swap_int16(int16_t);
 //uint16_t swap_uint16(uint16_t);
 //uint32_t swap_uint32(uint32_t);
 
 //basic
+uint8_t readFont(uint8_t);
 uint8_t readTableDirectory(uint8_t);
 uint32_t calculateCheckSum(uint32_t, uint32_t);
 uint32_t seekToTable(const char *name);
@@ -206,12 +277,15 @@ void readHeadTable();
 void readCoords(char, uint16_t);
 //Glyph
 uint32_t getGlyphOffset(uint16_t);
-uint16_t codeToGlyphId(uint16_t);
+uint16_t codeToGlyphId(uint32_t);
+uint16_t segmentToGlyphId(uint16_t, uint16_t);
+uint16_t groupToGlyphId(uint32_t);
 uint8_t readSimpleGlyph(uint8_t);
 uint8_t readCompoundGlyph();
 
 //cmap. maps character codes to glyph indices
 uint8_t readCmapFormat4();
+uint8_t readCmapFormat12();
 uint8_t readCmap();
 //hmtx. metric information for the horizontal layout each of the glyphs
 uint8_t readHMetric();
@@ -233,30 +307,35 @@ void freeBeginPoints();
 uint8_t addEndPoint(uint16_t);
 void freeEndPoints();
 void addLine(uint16_t, uint16_t, uint16_t, uint16_t);
+void addSpan(uint16_t, uint16_t, uint16_t);
 int32_t isLeft(ttCoordinate_t *_p0, ttCoordinate_t *_p1, ttCoordinate_t *_point);
 //private function prototype end
 
 //----------
+#if TRUETYPE_USE_FATFS
+//font from bitmap_truetype_fs.File (opened by the application)
 uint8_t truetype_setTtfFile(uint8_t _checkCheckSum){
-	if(readTableDirectory(_checkCheckSum) == 0){
-		f_close(&bitmap_truetype_fs.File);
-		return 1;
-	}
-
-	if (readCmap() == 0) {
-		f_close(&bitmap_truetype_fs.File);
-		return 2;
-	}
+	ttfMemory = NULL;
+	ttfLength = 0;
+	cacheReset();
+	glyphCacheClear();
 
-	if (readHMetric() == 0) {
+	uint8_t result = readFont(_checkCheckSum);
+	if(result != 0){
 		f_close(&bitmap_truetype_fs.File);
-		return 3;
 	}
+	return result;
+}
+#endif
 
-	readKern();
-	readHeadTable();
+//font from memory (internal flash, memory mapped QSPI, RAM): read in place, no file system access. _data must stay valid
+uint8_t truetype_setTtfMemory(const uint8_t *_data, size_t _length){
+	ttfMemory = _data;
+	ttfLength = _length;
+	cacheReset();
+	glyphCacheClear();
 
-	return 0;
+	return readFont(0);
 }
 
 void truetype_setCharacterSize(uint16_t _characterSize){
@@ -274,7 +353,7 @@ void truetype_setTextBoundary(uint16_t _start_x, uint16_t _end_x, uint16_t _end_
 	bitmap_truetype_param.end_y = _end_y;
 }
 
-void truetype_setTextColor(uint8_t _onLine, uint8_t _inside, uint8_t _fill){
+void truetype_setTextColor(bitmap_color_t _onLine, bitmap_color_t _inside, uint8_t _fill){
 	bitmap_truetype_param.colorLine = _onLine;
 	bitmap_truetype_param.colorInside = _inside;
 	bitmap_truetype_param.fillInside = _fill;
@@ -301,6 +380,21 @@ void truetype_setTextRotation(uint16_t _rotation){
 	bitmap_truetype_param.stringRotation = _rotation;
 }
 
+//byte budget of the glyph cache, 0: off. Masks over the new budget are dropped
+void truetype_setGlyphCache(uint32_t _bytes){
+	glyphCacheBudget = _bytes;
+	while(bitmap_truetype_glyphCache.bytes > glyphCacheBudget){
+		ttGlyphCache_t *oldest = NULL;
+		for(uint8_t i = 0; i < TRUETYPE_GLYPH_CACHE_ENTRIES; i++){
+			if((glyphCache[i].mask != NULL) && ((oldest == NULL) || (glyphCache[i].used < oldest->used))){
+				oldest = &glyphCache[i];
+			}
+		}
+		glyphCacheFree(oldest);
+		bitmap_truetype_glyphCache.evictions++;
+	}
+}
+
 void truetype_textDraw(int32_t _x, int32_t _y, char _character[]){
 	uint16_t length = 0;
 	while(_character[length] != '\0'){
@@ -327,8 +421,19 @@ void truetype_textDrawL(int32_t _x, int32_t _y, wchar_t _character[]){
 			continue;
 		}
 
-		charCode = codeToGlyphId(_character[c]);
-		readGlyph(charCode, 0);
+		//cached glyph: no outline to read. Not while recording a display list, it keeps images by reference
+		uint16_t glyphId = codeToGlyphId(_character[c]);
+		ttGlyphCache_t *cached = (bitmap_list.cmd == NULL) ? glyphCacheFind(glyphId) : NULL;
+		ttHMetric_t hMetric;
+		uint16_t width;
+		if(cached != NULL){
+			charCode = cached->metricCode;
+			hMetric = cached->hMetric;
+			width = cached->width;
+		}else{
+			charCode = glyphId;
+			readGlyph(charCode, 0);
+		}
 
 		//sprintf(string, "%c:%d,%d", _character[c], charCode, glyph.numberOfContours);
 		//bitmap_terminal(string, 0, 0xff, TERMINAL_LINE_MAX);
@@ -340,8 +445,10 @@ void truetype_textDrawL(int32_t _x, int32_t _y, wchar_t _character[]){
 		}
 		prev_code = charCode;
 
-		ttHMetric_t hMetric = getHMetric(charCode);
-		uint16_t width = bitmap_truetype_param.characterSize * (glyph.xMax - glyph.xMin) / (yMax - yMin);
+		if(cached == NULL){
+			hMetric = getHMetric(charCode);
+			width = bitmap_truetype_param.characterSize * (glyph.xMax - glyph.xMin) / (yMax - yMin);
+		}
 
 		//Line breaks when reaching the edge of the display
 		if((hMetric.leftSideBearing + width + _x) > bitmap_truetype_param.end_x){
@@ -354,39 +461,78 @@ void truetype_textDrawL(int32_t _x, int32_t _y, wchar_t _character[]){
 
 		//Line breaks with line feed code
 		if(_character[c] == '\n'){
+			if(cached == NULL){
+				freeGlyph();
+			}
 			_x = bitmap_truetype_param.start_x;
 			_y += bitmap_truetype_param.characterSize;
 			if(_y > bitmap_truetype_param.end_y){
 				break;
 			}
+			c++;
 			continue;
 		}
 
-		//Not compatible with Compound glyphs now
-		if(glyph.numberOfContours >= 0){
-			//write framebuffer
-			generateOutline(hMetric.leftSideBearing + _x, _y, width);
+		if(cached != NULL){
+			bitmap_truetype_glyphCache.hits++;
+			glyphCacheDraw(cached, hMetric.leftSideBearing + _x, _y);
+		}else{
+			//Not compatible with Compound glyphs now
+			if(glyph.numberOfContours >= 0){
+				ttGlyphCache_t *added = (bitmap_list.cmd == NULL) ? glyphCacheAdd(glyphId, width, hMetric) : NULL;
+				if(added != NULL){
+					glyphCacheDraw(added, hMetric.leftSideBearing + _x, _y);
+				}else{
+					//write framebuffer
+					generateOutline(hMetric.leftSideBearing + _x, _y, width);
 
-			//fill charctor
-			if(bitmap_truetype_param.fillInside){
-				fillGlyph(hMetric.leftSideBearing + _x, _y, width);
+					//fill charctor
+					if(bitmap_truetype_param.fillInside){
+						fillGlyph(hMetric.leftSideBearing + _x, _y, width);
+					}
+				}
 			}
+			freePointsAll();
+			freeGlyph();
 		}
-		freePointsAll();
-		freeGlyph();
 
 		_x += (hMetric.advanceWidth) ? (hMetric.advanceWidth) : (width);
 		c++;
 	}
 }
 
+//parse the tables of the selected source. 0: ok, 1: table directory / checksum, 2: cmap, 3: hmtx
+uint8_t readFont(uint8_t _checkCheckSum){
+	if(readTableDirectory(_checkCheckSum) == 0){
+		return 1;
+	}
+
+	if (readCmap() == 0) {
+		return 2;
+	}
+
+	if (readHMetric() == 0) {
+		return 3;
+	}
+
+	readKern();
+	readHeadTable();
+
+	return 0;
+}
+
 uint8_t readTableDirectory(uint8_t _checkCheckSum){
-	bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, numTablesPos);
+	setReadPosition(numTablesPos);
 	numTables = getUInt16t();
 
+	free(table);
 	table = (ttTable_t *)malloc(sizeof(ttTable_t) * numTables);
+	if(table == NULL){
+		numTables = 0;
+		return 0;
+	}
 
-	bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, tablePos);
+	setReadPosition(tablePos);
 
 	//bitmap_terminal("---table list---", 0, 0xff, TERMINAL_LINE_MAX);
 	for (int i = 0; i < numTables; i++) {
@@ -430,7 +576,10 @@ uint16_t truetype_getStringWidthL(wchar_t _character[]){
 			continue;
 		}
 		uint16_t code = codeToGlyphId(_character[c]);
-		readGlyph(code, 1);
+		ttGlyphCache_t *cached = glyphCacheFind(code); //only the width, no need to read the glyph header
+		if(cached == NULL){
+			readGlyph(code, 1);
+		}
 
 		output += bitmap_truetype_param.characterSpace;
 		if(prev_code != 0 && bitmap_truetype_param.kerningOn){
@@ -440,7 +589,7 @@ uint16_t truetype_getStringWidthL(wchar_t _character[]){
 		prev_code = code;
 
 		ttHMetric_t hMetric = getHMetric(code);
-		uint16_t width = bitmap_truetype_param.characterSize * (glyph.xMax - glyph.xMin) / (yMax - yMin);
+		uint16_t width = (cached != NULL) ? cached->width : (bitmap_truetype_param.characterSize * (glyph.xMax - glyph.xMin) / (yMax - yMin));
 		output += (hMetric.advanceWidth) ? (hMetric.advanceWidth) : (width);
 		c++;
 	}
@@ -466,7 +615,7 @@ uint32_t calculateCheckSum(uint32_t _offset, uint32_t _length){
 	uint32_t checksum = 0;
 
 	_length = (_length + 3) / 4;
-	bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, _offset);
+	setReadPosition(_offset);
 
 	while (_length-- > 0) {
 	checksum += getUInt32t();
@@ -477,7 +626,7 @@ uint32_t calculateCheckSum(uint32_t _offset, uint32_t _length){
 void readHeadTable(){
 	for (int i = 0; i < numTables; i++) {
 		if (strcmp(table[i].name, "head") == 0) {
-			bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, table[i].offset);
+			setReadPosition(table[i].offset);
 
 			headTable.version = getUInt32t();
 			headTable.revision = getUInt32t();
@@ -485,12 +634,8 @@ void readHeadTable(){
 			headTable.magicNumber = getUInt32t();
 			headTable.flags = getUInt16t();
 			headTable.unitsPerEm = getUInt16t();
-			for (int j = 0; j < 8; j++) {
-				headTable.created[i] = getUInt8t();
-			}
-			for (int j = 0; j < 8; j++) {
-				headTable.modified[i] = getUInt8t();
-			}
+			readBytes((uint8_t *)headTable.created, 8);
+			readBytes((uint8_t *)headTable.modified, 8);
 			xMin = headTable.xMin = getInt16t();
 			yMin = headTable.yMin = getInt16t();
 			xMax = headTable.xMax = getInt16t();
@@ -546,7 +691,7 @@ void readCoords(char _xy, uint16_t _startPoint){
 uint32_t seekToTable(const char *_name){
 	for (uint32_t i = 0; i < numTables; i++) {
 		if (strcmp(table[i].name, _name) == 0) {
-			bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, table[i].offset);
+			setReadPosition(table[i].offset);
 			return table[i].offset;
 		}
 	}
@@ -556,6 +701,7 @@ uint32_t seekToTable(const char *_name){
 uint8_t readCmap(){
 	uint16_t platformId, platformSpecificId;
 	uint32_t cmapOffset, tableOffset;
+	uint32_t format4Offset = 0, format12Offset = 0;
 	uint8_t foundMap = 0;
 
 	if ((cmapOffset = seekToTable("cmap")) == 0) {
@@ -571,22 +717,41 @@ uint8_t readCmap(){
 		tableOffset = getUInt32t();
 
 		if ((platformId == 3) && (platformSpecificId == 1)) {
-			cmapFormat4.offset = cmapOffset + tableOffset;
-			readCmapFormat4();
-			foundMap = 1;
-			break;
+			format4Offset = cmapOffset + tableOffset;
+		}
+		if ((platformId == 3) && (platformSpecificId == 10)) {
+			format12Offset = cmapOffset + tableOffset;
 		}
 	}
 
+	//full Unicode table first, BMP table otherwise
+	cmapFormat4.segCountX2 = 0;
+	cmapFormat12.numGroups = 0;
+	if (format12Offset != 0) {
+		cmapFormat12.offset = format12Offset;
+		foundMap = readCmapFormat12();
+	}
+	if ((foundMap == 0) && (format4Offset != 0)) {
+		cmapFormat4.offset = format4Offset;
+		foundMap = readCmapFormat4();
+	}
+
 	if (foundMap == 0) {
 		return 0;
 	}
 
+	for(uint16_t i = 0; i < 128; i++){
+		cmapAscii[i] = 0;
+	}
+	for(uint16_t i = 0; i < 128; i++){
+		cmapAscii[i] = codeToGlyphId(i);
+	}
+
 	return 1;
 }
 
 uint8_t readCmapFormat4(){
-	bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, cmapFormat4.offset);
+	setReadPosition(cmapFormat4.offset);
 	if ((cmapFormat4.format = getUInt16t()) != 4) {
 		return 0;
 	}
@@ -603,15 +768,50 @@ uint8_t readCmapFormat4(){
 	cmapFormat4.idRangeOffsetOffset = cmapFormat4.idDeltaOffset + cmapFormat4.segCountX2;
 	cmapFormat4.glyphIndexArrayOffset = cmapFormat4.idRangeOffsetOffset + cmapFormat4.segCountX2;
 
+	//segment arrays once into RAM: lookups binary search them without reading the file
+	uint16_t segCount = cmapFormat4.segCountX2 / 2;
+	free(cmapFormat4.endCode);
+	cmapFormat4.endCode = (uint16_t *)malloc(sizeof(uint16_t) * 4 * segCount);
+	if((cmapFormat4.endCode == NULL) || (segCount == 0)){
+		cmapFormat4.segCountX2 = 0;
+		return 0;
+	}
+	cmapFormat4.startCode = &cmapFormat4.endCode[segCount];
+	cmapFormat4.idDelta = (int16_t *)&cmapFormat4.endCode[2 * segCount];
+	cmapFormat4.idRangeOffset = &cmapFormat4.endCode[3 * segCount];
+
+	setReadPosition(cmapFormat4.endCodeOffset);
+	readU16Array(cmapFormat4.endCode, segCount);
+	setReadPosition(cmapFormat4.startCodeOffset);
+	readU16Array(cmapFormat4.startCode, segCount);
+	readU16Array((uint16_t *)cmapFormat4.idDelta, segCount);
+	readU16Array(cmapFormat4.idRangeOffset, segCount);
+
 	return 1;
 }
 
+//groups stay in the file (up to thousands in large fonts): binary searched through the block cache
+uint8_t readCmapFormat12(){
+	setReadPosition(cmapFormat12.offset);
+	if ((cmapFormat12.format = getUInt16t()) != 12) {
+		return 0;
+	}
+
+	getUInt16t(); //reserved
+	cmapFormat12.length = getUInt32t();
+	cmapFormat12.language = getUInt32t();
+	cmapFormat12.numGroups = getUInt32t();
+	cmapFormat12.groupsOffset = cmapFormat12.offset + 16;
+
+	return (cmapFormat12.numGroups != 0);
+}
+
 uint8_t readHMetric(){
 	if (seekToTable("hmtx") == 0) {
 		return 0;
 	}
 
-	hmtxTablePos = f_tell(&bitmap_truetype_fs.File);
+	hmtxTablePos = getReadPosition();
 	return 1;
 }
 
@@ -619,7 +819,7 @@ ttHMetric_t getHMetric(uint16_t _code){
 	ttHMetric_t result;
 	result.advanceWidth = 0;
 
-	bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, hmtxTablePos + (_code * 4));
+	setReadPosition(hmtxTablePos + (_code * 4));
 	result.advanceWidth = getUInt16t();
 	result.leftSideBearing = getInt16t();
 
@@ -646,20 +846,20 @@ uint8_t readKern(){
 		uint16_t format;
 
 		kernSubtable.length = getUInt32t();
-		nextTable = f_tell(&bitmap_truetype_fs.File) + kernSubtable.length;
+		nextTable = getReadPosition() + kernSubtable.length;
 		kernSubtable.coverage = getUInt16t();
 
 		format = (uint16_t)(kernSubtable.coverage >> 8);
 
 		// only support format0
 		if(format != 0){
-			bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, nextTable);
+			setReadPosition(nextTable);
 			continue;
 		}
 
 		// only use horizontal kerning tables
 		if ((kernSubtable.coverage & 0x0003) != 0x0001){
-			bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, nextTable);
+			setReadPosition(nextTable);
 			continue;
 		}
 
@@ -668,7 +868,7 @@ uint8_t readKern(){
 		kernFormat0.searchRange = getUInt16t();
 		kernFormat0.entrySelector = getUInt16t();
 		kernFormat0.rangeShift = getUInt16t();
-		kernTablePos = f_tell(&bitmap_truetype_fs.File);
+		kernTablePos = getReadPosition();
 
 		break;
 	}
@@ -681,7 +881,7 @@ int16_t getKerning(uint16_t _left_glyph, uint16_t _right_glyph){
 	int16_t result = 0;
 	uint32_t key0 = ((uint32_t)(_left_glyph) << 16) | (_right_glyph);
 
-	bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, kernTablePos);
+	setReadPosition(kernTablePos);
 
 	for(uint16_t i = 0; i < kernFormat0.nPairs; i++){
 		uint32_t key1 = getUInt32t();
@@ -689,7 +889,7 @@ int16_t getKerning(uint16_t _left_glyph, uint16_t _right_glyph){
 			result = getInt16t();
 			break;
 		}
-		bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, f_tell(&bitmap_truetype_fs.File) + 2);
+		setReadPosition(getReadPosition() + 2);
 	}
 
 	return result;
@@ -917,6 +1117,7 @@ uint8_t fillGlyph(uint16_t _x_min, uint16_t _y_min, uint16_t _width){
 		}
 
 		int16_t windingNumber = 0;
+		int32_t runStart = -1; //inside pixels are drawn as horizontal runs
 		for(uint16_t x = _x_min; x < (_x_min + _width); x++){
 			windingNumber = 0;
 			point.x = x;
@@ -936,10 +1137,16 @@ uint8_t fillGlyph(uint16_t _x_min, uint16_t _y_min, uint16_t _width){
 				}
 			}
 
-			if(windingNumber != 0){
-				bitmap_pixel(x, y, bitmap_truetype_param.colorInside);
+			if((windingNumber != 0) && (runStart < 0)){
+				runStart = x;
+			}else if((windingNumber == 0) && (runStart >= 0)){
+				addSpan(runStart, x - 1, y);
+				runStart = -1;
 			}
 		}
+		if(runStart >= 0){
+			addSpan(runStart, _x_min + _width - 1, y);
+		}
 
 		free(pointsToFill);
 		pointsToFill = NULL;
@@ -949,7 +1156,7 @@ uint8_t fillGlyph(uint16_t _x_min, uint16_t _y_min, uint16_t _width){
 
 uint8_t readGlyph(uint16_t _code, uint8_t _justSize){
 	uint32_t offset = getGlyphOffset(_code);
-	bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, offset);
+	setReadPosition(offset);
 	glyph.numberOfContours = getInt16t();
 	glyph.xMin = getInt16t();
 	glyph.yMin = getInt16t();
@@ -980,10 +1187,10 @@ uint32_t getGlyphOffset(uint16_t _index){
 	for (int i = 0; i < numTables; i++) {
 		if (strcmp(table[i].name, "loca") == 0) {
 			if (headTable.indexToLocFormat == 1) {
-				bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, (table[i].offset + _index * 4));
+				setReadPosition(table[i].offset + _index * 4);
 				offset = getUInt32t();
 			} else {
-				bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, (table[i].offset + _index * 2));
+				setReadPosition(table[i].offset + _index * 2);
 				offset = getUInt16t() * 2;
 			}
 			break;
@@ -999,42 +1206,77 @@ uint32_t getGlyphOffset(uint16_t _index){
 	return 0;
 }
 
-uint16_t codeToGlyphId(uint16_t _code){
-	uint16_t start, end, idRangeOffset;
-	int16_t idDelta;
-	uint8_t found = 0;
-	uint16_t offset, glyphId;
-
-	for (int i = 0; i < cmapFormat4.segCountX2 / 2; i++) {
-		bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, (cmapFormat4.endCodeOffset + 2 * i));
-		end = getUInt16t();
-		if (_code <= end) {
-			bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, (cmapFormat4.startCodeOffset + 2 * i));
-			start = getUInt16t();
-			if (_code >= start) {
-				bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, (cmapFormat4.idDeltaOffset + 2 * i));
-				idDelta = getInt16t();
-				bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, (cmapFormat4.idRangeOffsetOffset + 2 * i));
-				idRangeOffset = getUInt16t();
-				if (idRangeOffset == 0) {
-					glyphId = (idDelta + _code) % 65536;
-				} else {
-					offset = (idRangeOffset / 2 + i + _code - start - cmapFormat4.segCountX2 / 2) * 2;
-					bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, (cmapFormat4.glyphIndexArrayOffset + offset));
-					glyphId = getUInt16t();
-				}
+uint16_t codeToGlyphId(uint32_t _code){
+	if((_code < 128) && (cmapAscii[_code] != 0)){
+		return cmapAscii[_code];
+	}
+	if(cmapFormat12.numGroups != 0){
+		return groupToGlyphId(_code);
+	}
+	if(_code > 0xffff){
+		return 0;
+	}
 
-				found = 1;
-				break;
-			}
+	//first segment with endCode >= _code
+	uint16_t low = 0;
+	uint16_t high = cmapFormat4.segCountX2 / 2;
+	while(low < high){
+		uint16_t middle = (low + high) / 2;
+		if(cmapFormat4.endCode[middle] < _code){
+			low = middle + 1;
+		}else{
+			high = middle;
 		}
 	}
-	if (!found) {
+	if((low == (cmapFormat4.segCountX2 / 2)) || (_code < cmapFormat4.startCode[low])){
 		return 0;
 	}
+	return segmentToGlyphId(low, _code);
+}
+
+uint16_t segmentToGlyphId(uint16_t _segment, uint16_t _code){
+	uint16_t idRangeOffset = cmapFormat4.idRangeOffset[_segment];
+	if (idRangeOffset == 0) {
+		return (cmapFormat4.idDelta[_segment] + _code) % 65536;
+	}
+
+	//glyphIdArray stays in the file: read through the block cache
+	uint16_t offset = (idRangeOffset / 2 + _segment + _code - cmapFormat4.startCode[_segment] - cmapFormat4.segCountX2 / 2) * 2;
+	setReadPosition(cmapFormat4.glyphIndexArrayOffset + offset);
+	uint16_t glyphId = getUInt16t();
+	if (glyphId != 0) {
+		glyphId = (glyphId + cmapFormat4.idDelta[_segment]) % 65536;
+	}
 	return glyphId;
 }
 
+//format12: first group with endCharCode >= _code, about log2(numGroups) reads of one value
+uint16_t groupToGlyphId(uint32_t _code){
+	uint32_t low = 0;
+	uint32_t high = cmapFormat12.numGroups;
+	while(low < high){
+		uint32_t middle = low + (high - low) / 2;
+		setReadPosition(cmapFormat12.groupsOffset + (middle * 12) + 4);
+		if(getUInt32t() < _code){
+			low = middle + 1;
+		}else{
+			high = middle;
+		}
+	}
+	if(low == cmapFormat12.numGroups){
+		return 0;
+	}
+
+	setReadPosition(cmapFormat12.groupsOffset + (low * 12));
+	uint32_t start = getUInt32t();
+	getUInt32t();
+	uint32_t startGlyph = getUInt32t();
+	if(_code < start){
+		return 0;
+	}
+	return startGlyph + (_code - start);
+}
+
 uint8_t readSimpleGlyph(uint8_t _addGlyph){
 	uint8_t repeatCount;
 	uint8_t flag;
@@ -1062,11 +1304,13 @@ uint8_t readSimpleGlyph(uint8_t _addGlyph){
 		glyph.endPtsOfContours = (uint16_t *)malloc((sizeof(uint16_t) * glyph.numberOfContours));
 	}
 
+	readU16Array(&glyph.endPtsOfContours[counterContours], glyph.numberOfContours - counterContours);
 	for (uint16_t i = counterContours; i < glyph.numberOfContours; i++) {
-		glyph.endPtsOfContours[i] = counterPoints + getUInt16t();
+		glyph.endPtsOfContours[i] += counterPoints;
 	}
 
-	bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, (getUInt16t() + f_tell(&bitmap_truetype_fs.File)));
+	uint16_t instructionLength = getUInt16t();
+	setReadPosition(getReadPosition() + instructionLength);
 
 	for (uint16_t i = counterContours; i < glyph.numberOfContours; i++) {
 		if (glyph.endPtsOfContours[i] > glyph.numberOfPoints) {
@@ -1138,19 +1382,19 @@ uint8_t readCompoundGlyph(){
 			charCode = glyphIndex;
 		}
 
-		offset = f_tell(&bitmap_truetype_fs.File);
+		offset = getReadPosition();
 
 		uint32_t glyphOffset = getGlyphOffset(glyphIndex);
-		bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, glyphOffset);
+		setReadPosition(glyphOffset);
 		glyph.numberOfContours += getInt16t();
-		bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, glyphOffset + 10);
+		setReadPosition(glyphOffset + 10);
 
 		if(numberOfGlyphs == 0){
 			readSimpleGlyph(0);
 		}else{
 			readSimpleGlyph(1);
 		}
-		bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, offset);
+		setReadPosition(offset);
 
 		numberOfGlyphs++;
 		glyphTransformation.dx = 0;
@@ -1170,12 +1414,27 @@ void addLine(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1){
 	}
 	addPoint(_x1, _y1);
 
-	bitmap_line(_x0, _y0, _x1, _y1, bitmap_truetype_param.colorLine);
+	if(glyphTarget != NULL){
+		bitmap_surfaceLine(glyphTarget, _x0, _y0, _x1, _y1, BITMAP_COLOR8(0xff));
+	}else{
+		bitmap_line(_x0, _y0, _x1, _y1, bitmap_truetype_param.colorLine);
+	}
+}
+
+//inside run of fillGlyph
+void addSpan(uint16_t _x0, uint16_t _x1, uint16_t _y){
+	if(glyphTarget != NULL){
+		bitmap_surfaceHspan(glyphTarget, _x0, _x1, _y, BITMAP_COLOR8(0xff));
+	}else{
+		bitmap_fillrect(_x0, _y, _x1, _y, bitmap_truetype_param.colorInside);
+	}
 }
 
 void freeGlyph(){
 	free(glyph.points);
 	free(glyph.endPtsOfContours);
+	glyph.points = NULL;
+	glyph.endPtsOfContours = NULL;
 	glyph.numberOfPoints = 0;
 }
 uint8_t addPoint(uint16_t _x, uint16_t _y){
@@ -1236,33 +1495,311 @@ int32_t isLeft(ttCoordinate_t *_p0, ttCoordinate_t *_p1, ttCoordinate_t *_point)
 }
 
 uint8_t getUInt8t(){
-	uint8_t x[1];
-
-	f_read(&bitmap_truetype_fs.File, x, 1, (unsigned int*)&bytesread);
+	uint8_t tmp[1];
+	const uint8_t *x = readPointer(1);
+	if(x == NULL){
+		readBytes(tmp, 1);
+		x = tmp;
+	}
 	return x[0];
 }
 int16_t getInt16t(){
-	uint8_t x[2];
-
-	f_read(&bitmap_truetype_fs.File, x, 2, (unsigned int*)&bytesread);
-	return (x[0] << 8) | x[1];
+	return (int16_t)getUInt16t();
 }
 uint16_t getUInt16t(){
-	uint8_t x[2];
-
-	f_read(&bitmap_truetype_fs.File, x, 2, (unsigned int*)&bytesread);
+	uint8_t tmp[2];
+	const uint8_t *x = readPointer(2);
+	if(x == NULL){
+		readBytes(tmp, 2);
+		x = tmp;
+	}
 	return (x[0] << 8) | x[1];
 }
 uint32_t getUInt32t(){
-	uint8_t x[4];
+	uint8_t tmp[4];
+	const uint8_t *x = readPointer(4);
+	if(x == NULL){
+		readBytes(tmp, 4);
+		x = tmp;
+	}
+	return ((uint32_t)x[0] << 24) | (x[1] << 16) | (x[2] << 8) | x[3];
+}
 
-	f_read(&bitmap_truetype_fs.File, x, 4, (unsigned int*)&bytesread);
-	return (x[0] << 24) | (x[1] << 16) | (x[2] << 8) | x[3];
+//_length bytes at readPosition in place (font memory or the current cache block), NULL: use readBytes
+const uint8_t *readPointer(uint8_t _length){
+	const uint8_t *p = NULL;
+	if(ttfMemory != NULL){
+		if((readPosition + _length) <= ttfLength){
+			p = &ttfMemory[readPosition];
+		}
+	}
+#if TRUETYPE_USE_FATFS
+	else if((cacheCurrent != NULL) && (cacheCurrent->block == (readPosition / TRUETYPE_CACHE_BLOCK_SIZE))){
+		uint16_t offset = readPosition % TRUETYPE_CACHE_BLOCK_SIZE;
+		if((offset + _length) <= cacheCurrent->length){
+			bitmap_truetype_cache.hits++;
+			p = &cacheCurrent->data[offset];
+		}
+	}
+#endif
+	if(p != NULL){
+		readPosition += _length;
+	}
+	return p;
+}
+
+void setReadPosition(uint32_t _position){
+	readPosition = _position;
+}
+
+uint32_t getReadPosition(){
+	return readPosition;
+}
+
+//_length bytes from readPosition. Bytes past the end of the file read as 0
+void readBytes(uint8_t *_buffer, uint32_t _length){
+	if(ttfMemory != NULL){
+		uint32_t n = (readPosition < ttfLength) ? (ttfLength - readPosition) : 0;
+		if(n > _length){
+			n = _length;
+		}
+		if(n > 0){
+			memcpy(_buffer, &ttfMemory[readPosition], n);
+		}
+		memset(&_buffer[n], 0, _length - n);
+		readPosition += _length;
+		return;
+	}
+
+#if TRUETYPE_USE_FATFS
+	while(_length > 0){
+		uint32_t block = readPosition / TRUETYPE_CACHE_BLOCK_SIZE;
+		uint16_t offset = readPosition % TRUETYPE_CACHE_BLOCK_SIZE;
+		ttCacheBlock_t *cache = cacheCurrent;
+		if((cache != NULL) && (cache->block == block)){
+			bitmap_truetype_cache.hits++;
+		}else{
+			cache = cacheGet(block);
+		}
+
+		if(offset >= cache->length){
+			memset(_buffer, 0, _length);
+			readPosition += _length;
+			return;
+		}
+		uint32_t n = cache->length - offset;
+		if(n > _length){
+			n = _length;
+		}
+		memcpy(_buffer, &cache->data[offset], n);
+		_buffer += n;
+		_length -= n;
+		readPosition += n;
+	}
+#else
+	//no font set
+	memset(_buffer, 0, _length);
+	readPosition += _length;
+#endif
+}
+
+//_count big endian uint16 values from readPosition
+void readU16Array(uint16_t *_array, uint16_t _count){
+	readBytes((uint8_t *)_array, (uint32_t)_count * 2);
+	for(uint16_t i = 0; i < _count; i++){
+		uint8_t *x = (uint8_t *)&_array[i];
+		_array[i] = (x[0] << 8) | x[1];
+	}
+}
+
+//forget the cached blocks, e.g. for another file
+void cacheReset(){
+#if TRUETYPE_USE_FATFS
+	for(uint8_t i = 0; i < TRUETYPE_CACHE_BLOCKS; i++){
+		cacheBlock[i].block = 0xffffffff;
+		cacheBlock[i].used = 0;
+	}
+	cacheCurrent = NULL;
+	cacheLastMiss = 0xffffffff;
+#endif
 }
 
+#if TRUETYPE_USE_FATFS
+
+//cached block _block. A miss right after a miss of the block before also reads the next block
+ttCacheBlock_t *cacheGet(uint32_t _block){
+	for(uint8_t i = 0; i < TRUETYPE_CACHE_BLOCKS; i++){
+		if(cacheBlock[i].block == _block){
+			bitmap_truetype_cache.hits++;
+			cacheBlock[i].used = ++cacheClock;
+			cacheCurrent = &cacheBlock[i];
+			return cacheCurrent;
+		}
+	}
+
+	bitmap_truetype_cache.misses++;
+	ttCacheBlock_t *cache = cacheLoad(_block);
+	if((TRUETYPE_CACHE_BLOCKS > 1) && (_block == (cacheLastMiss + 1)) && (cache->length == TRUETYPE_CACHE_BLOCK_SIZE)){
+		uint8_t cached = 0;
+		for(uint8_t i = 0; i < TRUETYPE_CACHE_BLOCKS; i++){
+			if(cacheBlock[i].block == (_block + 1)){
+				cached = 1;
+			}
+		}
+		if(!cached){
+			bitmap_truetype_cache.prefetches++;
+			cacheLoad(_block + 1);
+			//the requested block stays the most recently used
+			cache->used = ++cacheClock;
+		}
+	}
+	cacheLastMiss = _block;
+	cacheCurrent = cache;
+	return cache;
+}
+
+//read _block into the least recently used slot
+ttCacheBlock_t *cacheLoad(uint32_t _block){
+	ttCacheBlock_t *cache = &cacheBlock[0];
+	for(uint8_t i = 1; i < TRUETYPE_CACHE_BLOCKS; i++){
+		if(cacheBlock[i].used < cache->used){
+			cache = &cacheBlock[i];
+		}
+	}
+
+	cache->block = _block;
+	cache->used = ++cacheClock;
+	cache->length = 0;
+	bitmap_truetype_fs.fr = f_lseek(&bitmap_truetype_fs.File, _block * TRUETYPE_CACHE_BLOCK_SIZE);
+	if(bitmap_truetype_fs.fr == FR_OK){
+		bitmap_truetype_fs.fr = f_read(&bitmap_truetype_fs.File, cache->data, TRUETYPE_CACHE_BLOCK_SIZE, (unsigned int*)&bytesread);
+		if(bitmap_truetype_fs.fr == FR_OK){
+			cache->length = bytesread;
+		}
+	}
+	if(bitmap_truetype_fs.fr != FR_OK){
+		//read again next time
+		cache->block = 0xffffffff;
+	}
+	return cache;
+}
+#endif
+
 int32_t map(int32_t _cur_val, int32_t _cur_min, int32_t _cur_max, int32_t _new_min, int32_t _new_max){
 	int32_t cur_width = _cur_max - _cur_min;
 	int32_t new_width = _new_max - _new_min;
 
 	return new_width * (_cur_val - _cur_min) / cur_width + _new_min;
 }
+
+void glyphCacheClear(){
+	for(uint8_t i = 0; i < TRUETYPE_GLYPH_CACHE_ENTRIES; i++){
+		glyphCacheFree(&glyphCache[i]);
+	}
+}
+
+void glyphCacheFree(ttGlyphCache_t *_entry){
+	if(_entry->mask == NULL){
+		return;
+	}
+	bitmap_truetype_glyphCache.bytes -= 2 * (uint32_t)((_entry->width + 7) / 8) * _entry->characterSize;
+	free(_entry->mask);
+	_entry->mask = NULL;
+}
+
+//mask of _glyphId at the current size and rotation, NULL: not cached
+ttGlyphCache_t *glyphCacheFind(uint16_t _glyphId){
+	for(uint8_t i = 0; i < TRUETYPE_GLYPH_CACHE_ENTRIES; i++){
+		ttGlyphCache_t *entry = &glyphCache[i];
+		if((entry->mask != NULL) && (entry->glyphId == _glyphId) && (entry->characterSize == bitmap_truetype_param.characterSize) && (entry->rotation == bitmap_truetype_param.stringRotation)){
+			entry->used = ++glyphCacheClock;
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+//rasterize the loaded glyph into a new entry, evicting the least recently used ones. NULL: off, too large or no memory
+ttGlyphCache_t *glyphCacheAdd(uint16_t _glyphId, uint16_t _width, ttHMetric_t _hMetric){
+	uint16_t height = bitmap_truetype_param.characterSize;
+	uint32_t plane = (uint32_t)((_width + 7) / 8) * height;
+	if((_width == 0) || (height == 0) || ((2 * plane) > glyphCacheBudget)){
+		return NULL;
+	}
+
+	ttGlyphCache_t *entry = NULL;
+	while(1){
+		ttGlyphCache_t *oldest = NULL;
+		entry = NULL;
+		for(uint8_t i = 0; i < TRUETYPE_GLYPH_CACHE_ENTRIES; i++){
+			if(glyphCache[i].mask == NULL){
+				entry = &glyphCache[i];
+			}else if((oldest == NULL) || (glyphCache[i].used < oldest->used)){
+				oldest = &glyphCache[i];
+			}
+		}
+		if((entry != NULL) && ((bitmap_truetype_glyphCache.bytes + (2 * plane)) <= glyphCacheBudget)){
+			break;
+		}
+		glyphCacheFree(oldest);
+		bitmap_truetype_glyphCache.evictions++;
+	}
+
+	uint8_t *mask = (uint8_t *)calloc(2, plane);
+	bitmap_color_t *pixels = (bitmap_color_t *)malloc(sizeof(bitmap_color_t) * _width * height);
+	if((mask == NULL) || (pixels == NULL)){
+		free(mask);
+		free(pixels);
+		return NULL;
+	}
+
+	//the outline and the inside drawn at 0,0 of a scratch surface, kept as two planes
+	bitmap_surface_t scratch;
+	bitmap_surfaceInit(&scratch, pixels, _width, height, 0, BITMAP_COLOR8(0x00));
+	bitmap_surfaceClear(&scratch);
+	glyphTarget = &scratch;
+	generateOutline(0, 0, _width);
+	glyphCachePlane(pixels, mask, _width, height);
+	bitmap_surfaceClear(&scratch);
+	fillGlyph(0, 0, _width);
+	glyphCachePlane(pixels, &mask[plane], _width, height);
+	glyphTarget = NULL;
+	free(pixels);
+
+	entry->mask = mask;
+	entry->used = ++glyphCacheClock;
+	entry->glyphId = _glyphId;
+	entry->metricCode = charCode;
+	entry->characterSize = height;
+	entry->rotation = bitmap_truetype_param.stringRotation;
+	entry->width = _width;
+	entry->hMetric = _hMetric;
+	bitmap_truetype_glyphCache.bytes += 2 * plane;
+	bitmap_truetype_glyphCache.misses++;
+	return entry;
+}
+
+//drawn pixels of the scratch surface -> 1bpp rows
+void glyphCachePlane(bitmap_color_t *_pixels, uint8_t *_plane, uint16_t _width, uint16_t _height){
+	for(uint16_t y = 0; y < _height; y++){
+		for(uint16_t x = 0; x < _width; x++){
+			if(*_pixels++ != BITMAP_COLOR8(0x00)){
+				_plane[x >> 3] |= 0x80 >> (x & 7);
+			}
+		}
+		_plane += (_width + 7) / 8;
+	}
+}
+
+//outline, then the inside over it, as transparent 1bpp blits
+void glyphCacheDraw(ttGlyphCache_t *_entry, int32_t _x, int32_t _y){
+	bitmap_color_t palette[2] = {BITMAP_COLOR8(0x00), bitmap_truetype_param.colorLine};
+	bitmap_image_t image = {_entry->width, _entry->characterSize, 1, BITMAP_IMAGE_KEY, 0, _entry->mask, palette};
+	bitmap_blit(&image, _x, _y);
+
+	if(bitmap_truetype_param.fillInside){
+		palette[1] = bitmap_truetype_param.colorInside;
+		image.data = &_entry->mask[(uint32_t)((_entry->width + 7) / 8) * _entry->characterSize];
+		bitmap_blit(&image, _x, _y);
+	}
+}
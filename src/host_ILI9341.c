@@ -0,0 +1,101 @@
+/*
+ * host_ILI9341.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: k-omura
+ *
+ * Memory panel backend for ILI9341_setBackend(). Runs on a PC to profile and check flushes.
+ */
+
+#include <host_ILI9341.h>
+
+struct host_ILI9341_t host_ILI9341 = {.width = ILI9341_WIDTH, .height = ILI9341_HEIGHT};
+
+//open window and write position
+static struct {
+	uint16_t x0;
+	uint16_t y0;
+	uint16_t x1;
+	uint16_t y1;
+	uint16_t x;
+	uint16_t y;
+} window;
+
+static void hostCommand(uint8_t, const uint8_t*, uint8_t);
+static void hostWindow(uint16_t, uint16_t, uint16_t, uint16_t);
+static void hostPixels(const uint16_t*, uint32_t);
+static void hostFlush(void);
+const ILI9341_backend_t host_ILI9341_backend = {hostCommand, hostWindow, hostPixels, hostFlush};
+
+void host_ILI9341_resetCount(void) {
+	host_ILI9341.busWrites = 0;
+	host_ILI9341.commands = 0;
+	host_ILI9341.windows = 0;
+	host_ILI9341.pixels = 0;
+	host_ILI9341.frames = 0;
+}
+
+//binary PPM (P6) of the GRAM. returns 1 on success
+uint8_t host_ILI9341_writePPM(const char *_path) {
+	FILE *fp = fopen(_path, "wb");
+	if (fp == NULL) {
+		return 0;
+	}
+
+	fprintf(fp, "P6\n%u %u\n255\n", host_ILI9341.width, host_ILI9341.height);
+	for (uint32_t i = 0; i < ((uint32_t) host_ILI9341.width * host_ILI9341.height); i++) {
+		uint16_t c = host_ILI9341.gram[i];
+		uint8_t rgb[3] = {((c >> 11) & 0x1f) * 255 / 31, ((c >> 5) & 0x3f) * 255 / 63, (c & 0x1f) * 255 / 31};
+		fwrite(rgb, 1, 3, fp);
+	}
+	return (fclose(fp) == 0);
+}
+
+static void hostCommand(uint8_t _cmd, const uint8_t *_data, uint8_t _count) {
+	host_ILI9341.busWrites += 1 + _count;
+	host_ILI9341.commands++;
+
+	if ((_cmd == ILI9341_MAC) && (_count > 0)) {
+		uint8_t landscape = (_data[0] & ILI9341_MADCTL_MV) != 0;
+		host_ILI9341.width = landscape ? ILI9341_HEIGHT : ILI9341_WIDTH;
+		host_ILI9341.height = landscape ? ILI9341_WIDTH : ILI9341_HEIGHT;
+	}
+}
+
+static void hostWindow(uint16_t _x0, uint16_t _y0, uint16_t _x1, uint16_t _y1) {
+	host_ILI9341.busWrites += 11; //2 commands with 4 parameters each, memory write
+	host_ILI9341.windows++;
+
+	window.x0 = _x0;
+	window.y0 = _y0;
+	window.x1 = _x1;
+	window.y1 = _y1;
+	window.x = _x0;
+	window.y = _y0;
+}
+
+static void hostPixels(const uint16_t *_src, uint32_t _count) {
+	host_ILI9341.busWrites += _count;
+	host_ILI9341.pixels += _count;
+
+	for (uint32_t i = 0; i < _count; i++) {
+		if ((window.x < host_ILI9341.width) && (window.y < host_ILI9341.height)) {
+			host_ILI9341.gram[(uint32_t) window.y * host_ILI9341.width + window.x] = _src[i];
+		}
+		if (++window.x > window.x1) {
+			window.x = window.x0;
+			if (++window.y > window.y1) {
+				window.y = window.y0; //the panel wraps to the top of the window
+			}
+		}
+	}
+}
+
+static void hostFlush(void) {
+	host_ILI9341.frames++;
+	if (host_ILI9341.dump != NULL) {
+		char path[256];
+		snprintf(path, sizeof(path), host_ILI9341.dump, (unsigned long) host_ILI9341.frames);
+		host_ILI9341_writePPM(path);
+	}
+}
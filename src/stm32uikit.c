@@ -15,23 +15,23 @@
 #endif
 
 typedef struct {
-	uint8_t in;
-	uint8_t out;
-	uint8_t cont;
+	bitmap_color_t in;
+	bitmap_color_t out;
+	bitmap_color_t cont;
 	uint16_t height;
 } componentParam_t;
 
-componentParam_t comp_string = {0xff, 0xff, 0xff, 30};
-componentParam_t comp_pin = {0xda, 0xff, 0x96, 7};
-componentParam_t comp_progress = {0x04, 0x58, 0x3d, 6};
-componentParam_t comp_button = {0x14, 0x3d, 0x58, 30};
-componentParam_t comp_switch = {0x58, 0xda, 0xff, 22};
-componentParam_t comp_status = {0x5c, 0xda, 0xe1, 7};
-componentParam_t comp_anaMeter = {0x58, 0x31, 0xe1, 40};
-componentParam_t comp_cirMeter = {0x5c, 0x5c, 0x58, 50};
-componentParam_t comp_graph = {0xda, 0xda, 0xff, 120};
-
-void stm32uikit_componentSettings(uint8_t _comp_in, uint8_t _comp_out, uint8_t _comp_cont, uint16_t _height, uint8_t _component){
+componentParam_t comp_string = {BITMAP_COLOR8(0xff), BITMAP_COLOR8(0xff), BITMAP_COLOR8(0xff), 30};
+componentParam_t comp_pin = {BITMAP_COLOR8(0xda), BITMAP_COLOR8(0xff), BITMAP_COLOR8(0x96), 7};
+componentParam_t comp_progress = {BITMAP_COLOR8(0x04), BITMAP_COLOR8(0x58), BITMAP_COLOR8(0x3d), 6};
+componentParam_t comp_button = {BITMAP_COLOR8(0x14), BITMAP_COLOR8(0x3d), BITMAP_COLOR8(0x58), 30};
+componentParam_t comp_switch = {BITMAP_COLOR8(0x58), BITMAP_COLOR8(0xda), BITMAP_COLOR8(0xff), 22};
+componentParam_t comp_status = {BITMAP_COLOR8(0x5c), BITMAP_COLOR8(0xda), BITMAP_COLOR8(0xe1), 7};
+componentParam_t comp_anaMeter = {BITMAP_COLOR8(0x58), BITMAP_COLOR8(0x31), BITMAP_COLOR8(0xe1), 40};
+componentParam_t comp_cirMeter = {BITMAP_COLOR8(0x5c), BITMAP_COLOR8(0x5c), BITMAP_COLOR8(0x58), 50};
+componentParam_t comp_graph = {BITMAP_COLOR8(0xda), BITMAP_COLOR8(0xda), BITMAP_COLOR8(0xff), 120};
+
+void stm32uikit_componentSettings(bitmap_color_t _comp_in, bitmap_color_t _comp_out, bitmap_color_t _comp_cont, uint16_t _height, uint8_t _component){
 	componentParam_t temp = {_comp_in, _comp_out, _comp_cont, _height};
 	switch(_component){
 		case SET_STRING:
@@ -91,9 +91,13 @@ void stm32uikit_rectProgress(uint16_t _x0, uint16_t _y0, uint16_t _width, uint16
 		_val1000 = 1000;
 	}
 
+	uint16_t split = _x0 + 1 + ((_width - 2) * _val1000 / 1000);
 	bitmap_rect(_x0, _y0, x1, y1, 1, comp_progress.out);
-	bitmap_fillrect(_x0 + 1, _y0 + 1, x1 - 1, y1 - 1, comp_progress.in);
-	bitmap_fillrect(_x0 + 1, _y0 + 1, (_x0 + 1 + ((_width - 2) * _val1000 / 1000)), y1 - 1, comp_progress.cont);
+	//filled and empty parts side by side, no overdraw
+	bitmap_fillrect(_x0 + 1, _y0 + 1, split, y1 - 1, comp_progress.cont);
+	if(split < (x1 - 1)){
+		bitmap_fillrect(split + 1, _y0 + 1, x1 - 1, y1 - 1, comp_progress.in);
+	}
 }
 
 void stm32uikit_analogMeter(uint16_t _x0, uint16_t _y0, uint16_t _val1000){
@@ -134,6 +138,7 @@ void stm32uikit_circleMeter(uint16_t _x0, uint16_t _y0, uint16_t _val1000, uint1
 		_val1000 = 1000;
 	}
 
+	//clockwise from the top
 	uint16_t val360 = 360 * _val1000 / 1000;
 	uint16_t startAngle = 450 - val360;
 	uint16_t stopAngle = 450;
@@ -142,113 +147,8 @@ void stm32uikit_circleMeter(uint16_t _x0, uint16_t _y0, uint16_t _val1000, uint1
 		stopAngle -= 360;
 	}
 
-	uint16_t start360 = startAngle % 360;
-	uint16_t stop360 = stopAngle % 360;
-
-	int32_t f = 1 - width_x;
-	uint16_t ddF_x = 1;
-	int32_t ddF_y = -2 * width_x;
-	uint16_t x = 0;
-	int32_t y = width_x;
-
-	uint16_t circumference[9] = {0};
-	//circumference count
-	while (x < y) {
-		if (f >= 0) {
-			y--;
-			ddF_y += 2;
-			f += ddF_y;
-		}
-		x++;
-		ddF_x += 2;
-		f += ddF_x;
-
-		circumference[1]++;
-	}
-
-	for(uint8_t i = 2; i < 9; i++){
-		circumference[i] = circumference[i - 1] + circumference[1];
-		if((i % 2) == 0){
-			circumference[i]++;
-		}
-	}
-	circumference[1]++;
-
-	uint16_t startCircumference = (uint16_t)((circumference[8] * startAngle / 360));
-	uint16_t stopCircumference = (uint16_t)((circumference[8] * stopAngle / 360));
-	uint16_t circumferenceBorder = stopCircumference;
-	if((startAngle < 360) && (stopAngle > 360)){
-		circumferenceBorder -= circumference[8];
-	}
-
-	//re-init
-	f = 1 - width_x;
-	ddF_x = 1;
-	ddF_y = -2 * width_x;
-	x = 0;
-	y = width_x;
-
-	if((start360 == 0) || (stop360 == 0) || ((startAngle <= 360) && (stopAngle >= 360))){
-		bitmap_fillcircle(center_x + width_x, center_y, _thickness, 0 , comp_cirMeter.cont);
-	}
-	if((start360 == 90) || (stop360 == 90) || ((startAngle <= 90) && (stopAngle >= 90))){
-		bitmap_fillcircle(center_x, center_y - width_x, _thickness, 0 , comp_cirMeter.cont);
-	}
-	if((start360 == 180) || (stop360 == 180) || ((startAngle <= 180) && (stopAngle >= 180))){
-		bitmap_fillcircle(center_x - width_x, center_y, _thickness, 0 , comp_cirMeter.cont);
-	}
-	if((start360 == 270) || (stop360 == 270) || ((startAngle <= 270) && (stopAngle >= 270))){
-		bitmap_fillcircle(center_x, center_y + width_x, _thickness, 0 , comp_cirMeter.cont);
-	}
-
-	circumference[3] = circumference[3] + circumference[1];
-	circumference[5] = circumference[5] + circumference[1];
-	circumference[7] = circumference[7] + circumference[1];
-	circumference[1] = circumference[1] + circumference[1];
-	while (x < y) {
-		if (f >= 0) {
-			y--;
-			ddF_y += 2;
-			f += ddF_y;
-		}
-		x++;
-		ddF_x += 2;
-		f += ddF_x;
-
-		circumference[0]++;
-		circumference[1]--;
-		circumference[2]++;
-		circumference[3]--;
-		circumference[4]++;
-		circumference[5]--;
-		circumference[6]++;
-		circumference[7]--;
-
-		if(((startCircumference <= circumference[0]) && (stopCircumference >= circumference[0])) || ((stopAngle > 360) && (0 <= circumference[0]) && (circumferenceBorder >= circumference[0]))){
-			bitmap_fillcircle(center_x + y, center_y - x, _thickness, 0 , comp_cirMeter.cont);
-		}
-		if(((startCircumference <= circumference[1]) && (stopCircumference >= circumference[1])) || ((stopAngle > 360) && (0 <= circumference[1]) && (circumferenceBorder >= circumference[1]))){
-			bitmap_fillcircle(center_x + x, center_y - y, _thickness, 0 , comp_cirMeter.cont);
-		}
-		if(((startCircumference <= circumference[2]) && (stopCircumference >= circumference[2])) || ((stopAngle > 360) && (0 <= circumference[2]) && (circumferenceBorder >= circumference[2]))){
-			bitmap_fillcircle(center_x - x, center_y - y, _thickness, 0 , comp_cirMeter.cont);
-		}
-		if(((startCircumference <= circumference[3]) && (stopCircumference >= circumference[3])) || ((stopAngle > 360) && (0 <= circumference[3]) && (circumferenceBorder >= circumference[3]))){
-			bitmap_fillcircle(center_x - y, center_y - x, _thickness, 0 , comp_cirMeter.cont);
-		}
-		if(((startCircumference <= circumference[4]) && (stopCircumference >= circumference[4])) || ((stopAngle > 360) && (0 <= circumference[4]) && (circumferenceBorder >= circumference[4]))){
-			bitmap_fillcircle(center_x - y, center_y + x, _thickness, 0 , comp_cirMeter.cont);
-		}
-		if(((startCircumference <= circumference[5]) && (stopCircumference >= circumference[5])) || ((stopAngle > 360) && (0 <= circumference[5]) && (circumferenceBorder >= circumference[5]))){
-			bitmap_fillcircle(center_x - x, center_y + y, _thickness, 0 , comp_cirMeter.cont);
-		}
-		if(((startCircumference <= circumference[6]) && (stopCircumference >= circumference[6])) || ((stopAngle > 360) && (0 <= circumference[6]) && (circumferenceBorder >= circumference[6]))){
-			bitmap_fillcircle(center_x + x, center_y + y, _thickness, 0 , comp_cirMeter.cont);
-		}
-		if(((startCircumference <= circumference[7]) && (stopCircumference >= circumference[7])) || ((stopAngle > 360) && (0 <= circumference[7]) && (circumferenceBorder >= circumference[7]))){
-			bitmap_fillcircle(center_x + y, center_y + x, _thickness, 0 , comp_cirMeter.cont);
-		}
-	}
+	uint16_t inner = (_thickness < width_x) ? (width_x - _thickness) : 0;
+	bitmap_fillarc(center_x, center_y, inner, width_x + _thickness, startAngle, stopAngle, comp_cirMeter.cont);
 }
 
 void stm32uikit_graph(uint16_t _x0, uint16_t _y0, int16_t _y_min, int16_t _y_max, int16_t *_data180){
@@ -288,7 +188,7 @@ void stm32uikit_graph(uint16_t _x0, uint16_t _y0, int16_t _y_min, int16_t _y_max
 void stm32uikit_status(uint16_t _x0, uint16_t _y0, uint8_t _status){
 	bitmap_fillcircle(_x0, _y0, comp_status.height, 0, comp_status.out);
 
-	uint8_t col;
+	bitmap_color_t col;
 	switch(_status){
 		case 1:
 			col = comp_status.in;
@@ -326,7 +226,7 @@ void stm32uikit_sllideBar(Coordinate_t _touch, uint16_t _x0, uint16_t _y0, uint1
 }
 
 void stm32uikit_roundButton(Coordinate_t _touch, uint16_t _x0, uint16_t _y0, uint16_t _width, uint8_t *_val){
-	uint8_t comp_inside = ((*_val) == 1) ? (comp_button.cont) : (comp_button.in);
+	bitmap_color_t comp_inside = ((*_val) == 1) ? (comp_button.cont) : (comp_button.in);
 	bitmap_roundrect(_x0, _y0, _x0 + _width, _y0 + comp_button.height, 8, 1, comp_button.out);
 	bitmap_fillroundrect(_x0 + 1, _y0 + 1, _x0 + _width - 1, _y0 + comp_button.height - 1, 7, comp_inside);
 
@@ -340,7 +240,7 @@ void stm32uikit_roundButton(Coordinate_t _touch, uint16_t _x0, uint16_t _y0, uin
 }
 
 void stm32uikit_switch(Coordinate_t _touch, uint16_t _x0, uint16_t _y0, uint8_t *_val){
-	uint8_t comp_inside;
+	bitmap_color_t comp_inside;
 	uint16_t pin_x;
 	uint16_t round = comp_switch.height / 2;
 	uint16_t width = round * 3.5;